@@ -0,0 +1,532 @@
+#ifndef ASSET_STREAM_H
+#define ASSET_STREAM_H
+
+
+#include "basic.h"
+#include "str.h"
+#include "os.h"
+#include "sprite_atlas.h"
+
+
+/* NOTE
+ *
+ * Streams assets in off the render thread.
+ *
+ * Requests hand back a handle straight away. A worker thread reads and decodes the file into a staging
+ * buffer, and asset_stream_update() uploads staged textures a few rows at a time on the render thread,
+ * never more than the byte budget it's given per frame. The asset_stream_get_*() calls return nothing
+ * until the asset is ready, so callers just skip whatever hasn't arrived yet.
+ *
+ * asset_stream_reload() decodes the file again in the background and keeps serving the old version until
+ * the new one is fully uploaded, so reloading doesn't stall or blank the frame. Sprite atlases stay mapped
+ * while they're served, so whatever writes them has to rename a finished file into place, never rewrite it.
+ *
+ * Only the worker thread touches the staging fields, and only while the slot is LOADING. Everything else,
+ * including every function below, is render thread only.
+ *
+ * The worker runs code from whatever binary this is compiled into, so under hot reload the stream has to be
+ * closed before the module is unloaded.
+ *
+ */
+
+#define ASSET_STREAM_MAX_ASSETS 64
+#define ASSET_STREAM_PATH_MAX   256
+#define ASSET_STREAM_DEFAULT_UPLOAD_BUDGET MB(4)
+
+#define ASSET_KINDS         \
+  X(TEXTURE)                \
+  X(TEXT)                   \
+  X(SPRITE_ATLAS)           \
+
+typedef enum Asset_kind {
+  ASSET_KIND_INVALID = -1,
+#define X(kind) ASSET_KIND_##kind,
+  ASSET_KINDS
+#undef X
+    ASSET_KIND_MAX,
+} Asset_kind;
+
+#define ASSET_STATES        \
+  X(FREE)                   \
+  X(IDLE)                   \
+  X(QUEUED)                 \
+  X(LOADING)                \
+  X(DECODED)                \
+  X(FAILED)                 \
+
+typedef enum Asset_state {
+  ASSET_STATE_INVALID = -1,
+#define X(state) ASSET_STATE_##state,
+  ASSET_STATES
+#undef X
+    ASSET_STATE_MAX,
+} Asset_state;
+
+typedef struct Asset_handle Asset_handle;
+struct Asset_handle {
+  u32 index;
+  u32 generation;
+};
+
+typedef struct Asset_slot Asset_slot;
+struct Asset_slot {
+  u32 state; /* Asset_state, shared with the worker */
+  u32 generation;
+  Asset_kind kind;
+  b32 release_pending;
+  b32 reload_pending;
+  b32 loaded;
+  u32 version; /* bumped every time a new version goes live */
+
+  char path[ASSET_STREAM_PATH_MAX];
+
+  /* written by the worker */
+  Image        staging_image;
+  char        *staging_text;
+  Sprite_atlas staging_atlas;
+
+  /* upload in progress */
+  Texture2D upload_tex;
+  s32       upload_row;
+
+  /* what the game sees */
+  Texture2D    texture;
+  char        *text;
+  Sprite_atlas atlas;
+};
+
+typedef struct Asset_stream Asset_stream;
+struct Asset_stream {
+  Asset_slot slots[ASSET_STREAM_MAX_ASSETS];
+
+  OS_handle thread;
+  OS_handle mutex;
+  OS_handle cond;
+  b32 quit;
+
+  /* every slot is queued at most once, so this never overflows */
+  u32 queue[ASSET_STREAM_MAX_ASSETS];
+  u32 queue_head;
+  u32 queue_count;
+};
+
+
+void asset_stream_init(Asset_stream *stream);
+void asset_stream_close(Asset_stream *stream);
+
+Asset_handle asset_stream_request(Asset_stream *stream, Asset_kind kind, Str8 path);
+void asset_stream_reload(Asset_stream *stream, Asset_handle handle);
+void asset_stream_reload_path(Asset_stream *stream, Str8 path);
+void asset_stream_release(Asset_stream *stream, Asset_handle handle);
+
+void asset_stream_update(Asset_stream *stream, u64 upload_budget);
+
+b32           asset_stream_is_ready(Asset_stream *stream, Asset_handle handle);
+u32           asset_stream_version(Asset_stream *stream, Asset_handle handle);
+Texture2D     asset_stream_get_texture(Asset_stream *stream, Asset_handle handle);
+char*         asset_stream_get_text(Asset_stream *stream, Asset_handle handle);
+Sprite_atlas* asset_stream_get_sprite_atlas(Asset_stream *stream, Asset_handle handle, Texture2D *texture);
+
+
+#ifdef _UNITY_BUILD_
+#define ASSET_STREAM_IMPL
+#endif
+
+#ifdef ASSET_STREAM_IMPL
+
+
+internal Asset_slot* asset_stream_slot(Asset_stream *stream, Asset_handle handle) {
+  Asset_slot *result = 0;
+
+  if(handle.generation && handle.index < ASSET_STREAM_MAX_ASSETS) {
+    Asset_slot *slot = &stream->slots[handle.index];
+
+    if(slot->generation == handle.generation && atomic_read(&slot->state) != ASSET_STATE_FREE) {
+      result = slot;
+    }
+  }
+
+  return result;
+}
+
+internal void asset_stream_enqueue(Asset_stream *stream, u32 index) {
+  atomic_write(&stream->slots[index].state, ASSET_STATE_QUEUED);
+
+  os_mutex_scope(stream->mutex) {
+    ASSERT(stream->queue_count < ASSET_STREAM_MAX_ASSETS);
+    stream->queue[(stream->queue_head + stream->queue_count) % ASSET_STREAM_MAX_ASSETS] = index;
+    stream->queue_count++;
+    os_cond_signal(stream->cond);
+  }
+}
+
+internal void asset_stream_decode(Asset_slot *slot) {
+  b32 ok = 0;
+
+  switch(slot->kind) {
+    default:
+      UNREACHABLE;
+      break;
+    case ASSET_KIND_TEXTURE: {
+      slot->staging_image = LoadImage(slot->path);
+      ok = slot->staging_image.data != 0;
+    } break;
+    case ASSET_KIND_TEXT: {
+      slot->staging_text = LoadFileText(slot->path);
+      ok = slot->staging_text != 0;
+    } break;
+    case ASSET_KIND_SPRITE_ATLAS: {
+      ok = sprite_atlas_load(&slot->staging_atlas, str8_cstr(slot->path));
+
+      if(ok) {
+        /* fault the pages in here instead of on the render thread during the upload */
+        volatile u8 sink = 0;
+        for(u64 i = 0; i < slot->staging_atlas.size; i += KB(4)) {
+          sink ^= slot->staging_atlas.base[i];
+        }
+        (void)sink;
+      }
+    } break;
+  }
+
+  atomic_write(&slot->state, ok ? ASSET_STATE_DECODED : ASSET_STATE_FAILED);
+}
+
+internal void asset_stream_worker(void *arg) {
+  Asset_stream *stream = arg;
+
+  for(;;) {
+    s64 index = -1;
+
+    os_mutex_scope(stream->mutex) {
+      while(!stream->quit && stream->queue_count == 0) {
+        os_cond_wait(stream->cond, stream->mutex);
+      }
+
+      if(!stream->quit) {
+        index = stream->queue[stream->queue_head];
+        stream->queue_head = (stream->queue_head + 1) % ASSET_STREAM_MAX_ASSETS;
+        stream->queue_count--;
+      }
+    }
+
+    if(index < 0) {
+      break;
+    }
+
+    Asset_slot *slot = &stream->slots[index];
+    atomic_write(&slot->state, ASSET_STATE_LOADING);
+    asset_stream_decode(slot);
+  }
+}
+
+internal void asset_stream_free_staging(Asset_slot *slot) {
+  if(slot->staging_image.data) {
+    UnloadImage(slot->staging_image);
+    slot->staging_image = (Image){0};
+  }
+
+  if(slot->staging_text) {
+    UnloadFileText(slot->staging_text);
+    slot->staging_text = 0;
+  }
+
+  if(slot->staging_atlas.base) {
+    sprite_atlas_unload(&slot->staging_atlas);
+  }
+
+  if(slot->upload_tex.id) {
+    UnloadTexture(slot->upload_tex);
+    slot->upload_tex = (Texture2D){0};
+  }
+
+  slot->upload_row = 0;
+}
+
+internal void asset_stream_free_live(Asset_slot *slot) {
+  if(slot->texture.id) {
+    UnloadTexture(slot->texture);
+    slot->texture = (Texture2D){0};
+  }
+
+  if(slot->text) {
+    UnloadFileText(slot->text);
+    slot->text = 0;
+  }
+
+  if(slot->atlas.base) {
+    sprite_atlas_unload(&slot->atlas);
+  }
+
+  slot->loaded = 0;
+}
+
+/* returns how many bytes it uploaded, the texture is done once upload_row reaches the image height */
+internal u64 asset_stream_upload_rows(Asset_slot *slot, Image image, u64 budget) {
+  if(!slot->upload_tex.id) {
+    slot->upload_tex = (Texture2D) {
+      .id      = rlLoadTexture(0, image.width, image.height, image.format, 1),
+      .width   = image.width,
+      .height  = image.height,
+      .mipmaps = 1,
+      .format  = image.format,
+    };
+    slot->upload_row = 0;
+  }
+
+  u64 row_size = (u64)GetPixelDataSize(image.width, 1, image.format);
+  s32 rows = (s32)CLAMP_BOT(budget / row_size, 1);
+  rows = MIN(rows, image.height - slot->upload_row);
+
+  Rectangle rect = { 0, (f32)slot->upload_row, (f32)image.width, (f32)rows };
+  UpdateTextureRec(slot->upload_tex, rect, (u8*)image.data + row_size*slot->upload_row);
+
+  slot->upload_row += rows;
+
+  return row_size*rows;
+}
+
+void asset_stream_init(Asset_stream *stream) {
+  memory_zero(stream, sizeof(*stream));
+
+  stream->mutex = os_mutex_alloc();
+  stream->cond = os_cond_alloc();
+  stream->thread = os_thread_launch(asset_stream_worker, stream);
+}
+
+void asset_stream_close(Asset_stream *stream) {
+  os_mutex_scope(stream->mutex) {
+    stream->quit = 1;
+    os_cond_broadcast(stream->cond);
+  }
+
+  os_thread_join(stream->thread);
+
+  for(int i = 0; i < ASSET_STREAM_MAX_ASSETS; i++) {
+    Asset_slot *slot = &stream->slots[i];
+    asset_stream_free_staging(slot);
+    asset_stream_free_live(slot);
+  }
+
+  os_cond_release(stream->cond);
+  os_mutex_release(stream->mutex);
+
+  memory_zero(stream, sizeof(*stream));
+}
+
+Asset_handle asset_stream_request(Asset_stream *stream, Asset_kind kind, Str8 path) {
+  Asset_handle result = {0};
+
+  if(path.len >= ASSET_STREAM_PATH_MAX) {
+    TraceLog(LOG_ERROR, "asset path %.*s is too long", (int)path.len, path.s);
+    return result;
+  }
+
+  for(u32 i = 0; i < ASSET_STREAM_MAX_ASSETS; i++) {
+    Asset_slot *slot = &stream->slots[i];
+
+    if(atomic_read(&slot->state) != ASSET_STATE_FREE) {
+      continue;
+    }
+
+    u32 generation = slot->generation + 1;
+    memory_zero(slot, sizeof(*slot));
+    slot->generation = generation ? generation : 1;
+    slot->kind = kind;
+    memory_copy(slot->path, path.s, path.len);
+
+    result.index = i;
+    result.generation = slot->generation;
+
+    asset_stream_enqueue(stream, i);
+
+    return result;
+  }
+
+  TraceLog(LOG_ERROR, "out of asset slots, couldn't stream %.*s", (int)path.len, path.s);
+
+  return result;
+}
+
+void asset_stream_reload(Asset_stream *stream, Asset_handle handle) {
+  Asset_slot *slot = asset_stream_slot(stream, handle);
+
+  if(!slot || slot->release_pending) {
+    return;
+  }
+
+  u32 state = atomic_read(&slot->state);
+
+  if(state == ASSET_STATE_IDLE || state == ASSET_STATE_FAILED) {
+    asset_stream_enqueue(stream, handle.index);
+  } else if(state != ASSET_STATE_QUEUED) {
+    /* the file changed again while it was loading, go again once this version lands */
+    slot->reload_pending = 1;
+  }
+}
+
+void asset_stream_reload_path(Asset_stream *stream, Str8 path) {
+  for(u32 i = 0; i < ASSET_STREAM_MAX_ASSETS; i++) {
+    Asset_slot *slot = &stream->slots[i];
+
+    if(atomic_read(&slot->state) != ASSET_STATE_FREE && str8_match(str8_cstr(slot->path), path)) {
+      asset_stream_reload(stream, (Asset_handle){ .index = i, .generation = slot->generation });
+    }
+  }
+}
+
+void asset_stream_release(Asset_stream *stream, Asset_handle handle) {
+  Asset_slot *slot = asset_stream_slot(stream, handle);
+
+  if(slot) {
+    slot->release_pending = 1;
+  }
+}
+
+void asset_stream_update(Asset_stream *stream, u64 upload_budget) {
+  u64 uploaded = 0;
+
+  for(u32 i = 0; i < ASSET_STREAM_MAX_ASSETS; i++) {
+    Asset_slot *slot = &stream->slots[i];
+    u32 state = atomic_read(&slot->state);
+
+    if(state == ASSET_STATE_FREE || state == ASSET_STATE_QUEUED || state == ASSET_STATE_LOADING) {
+      continue;
+    }
+
+    if(slot->release_pending) {
+      asset_stream_free_staging(slot);
+      asset_stream_free_live(slot);
+      slot->release_pending = 0;
+      atomic_write(&slot->state, ASSET_STATE_FREE);
+      continue;
+    }
+
+    if(state == ASSET_STATE_FAILED) {
+      TraceLog(LOG_WARNING, "failed to stream %s%s", slot->path, slot->loaded ? ", keeping the old version" : "");
+      asset_stream_free_staging(slot);
+      atomic_write(&slot->state, ASSET_STATE_IDLE);
+      state = ASSET_STATE_IDLE;
+    }
+
+    if(state == ASSET_STATE_DECODED) {
+      b32 done = 0;
+
+      switch(slot->kind) {
+        default:
+          UNREACHABLE;
+          break;
+        case ASSET_KIND_TEXTURE: {
+          if(uploaded < upload_budget) {
+            uploaded += asset_stream_upload_rows(slot, slot->staging_image, upload_budget - uploaded);
+          }
+
+          if(slot->upload_row >= slot->staging_image.height) {
+            if(slot->texture.id) {
+              UnloadTexture(slot->texture);
+            }
+            slot->texture = slot->upload_tex;
+            slot->upload_tex = (Texture2D){0};
+            done = 1;
+          }
+        } break;
+        case ASSET_KIND_TEXT: {
+          if(slot->text) {
+            UnloadFileText(slot->text);
+          }
+          slot->text = slot->staging_text;
+          slot->staging_text = 0;
+          done = 1;
+        } break;
+        case ASSET_KIND_SPRITE_ATLAS: {
+          Image image = sprite_atlas_image(&slot->staging_atlas);
+
+          if(uploaded < upload_budget) {
+            uploaded += asset_stream_upload_rows(slot, image, upload_budget - uploaded);
+          }
+
+          if(slot->upload_row >= image.height) {
+            if(slot->texture.id) {
+              UnloadTexture(slot->texture);
+            }
+            if(slot->atlas.base) {
+              sprite_atlas_unload(&slot->atlas);
+            }
+            slot->texture = slot->upload_tex;
+            slot->atlas = slot->staging_atlas;
+            slot->upload_tex = (Texture2D){0};
+            slot->staging_atlas = (Sprite_atlas){0};
+            done = 1;
+          }
+        } break;
+      }
+
+      if(done) {
+        asset_stream_free_staging(slot);
+        slot->loaded = 1;
+        slot->version++;
+        atomic_write(&slot->state, ASSET_STATE_IDLE);
+        state = ASSET_STATE_IDLE;
+        TraceLog(LOG_DEBUG, "streamed in %s", slot->path);
+      }
+    }
+
+    if(state == ASSET_STATE_IDLE && slot->reload_pending) {
+      slot->reload_pending = 0;
+      asset_stream_enqueue(stream, i);
+    }
+  }
+}
+
+b32 asset_stream_is_ready(Asset_stream *stream, Asset_handle handle) {
+  Asset_slot *slot = asset_stream_slot(stream, handle);
+  return slot && slot->loaded;
+}
+
+/* 0 until the asset is ready, compare against the last version you saw to notice reloads */
+u32 asset_stream_version(Asset_stream *stream, Asset_handle handle) {
+  Asset_slot *slot = asset_stream_slot(stream, handle);
+  return (slot && slot->loaded) ? slot->version : 0;
+}
+
+Texture2D asset_stream_get_texture(Asset_stream *stream, Asset_handle handle) {
+  Texture2D result = {0};
+  Asset_slot *slot = asset_stream_slot(stream, handle);
+
+  if(slot && slot->loaded) {
+    ASSERT(slot->kind == ASSET_KIND_TEXTURE);
+    result = slot->texture;
+  }
+
+  return result;
+}
+
+char* asset_stream_get_text(Asset_stream *stream, Asset_handle handle) {
+  char *result = 0;
+  Asset_slot *slot = asset_stream_slot(stream, handle);
+
+  if(slot && slot->loaded) {
+    ASSERT(slot->kind == ASSET_KIND_TEXT);
+    result = slot->text;
+  }
+
+  return result;
+}
+
+Sprite_atlas* asset_stream_get_sprite_atlas(Asset_stream *stream, Asset_handle handle, Texture2D *texture) {
+  Sprite_atlas *result = 0;
+  Asset_slot *slot = asset_stream_slot(stream, handle);
+
+  if(slot && slot->loaded) {
+    ASSERT(slot->kind == ASSET_KIND_SPRITE_ATLAS);
+    result = &slot->atlas;
+    *texture = slot->texture;
+  }
+
+  return result;
+}
+
+
+#endif
+
+#endif
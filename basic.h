@@ -244,6 +244,21 @@
 #define memory_copy_typed(d,s,c) memory_copy((d),(s),sizeof(*(d))*(c))
 
 
+////////////////////////////////
+//~ Atomics
+
+#if COMPILER_CLANG || COMPILER_GCC
+# define atomic_read(p)          __atomic_load_n((p), __ATOMIC_ACQUIRE)
+# define atomic_write(p, v)      __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+# define atomic_swap(p, v)       __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+# define atomic_add_eval(p, v)   __atomic_add_fetch((p), (v), __ATOMIC_ACQ_REL)
+# define atomic_sub_eval(p, v)   __atomic_sub_fetch((p), (v), __ATOMIC_ACQ_REL)
+# define atomic_cas(p, expected, desired) __atomic_compare_exchange_n((p), (expected), (desired), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#else
+# error atomics not defined for this compiler.
+#endif
+
+
 ////////////////////////////////
 //~ rjf: Linked List Building Macros
 
@@ -0,0 +1,816 @@
+#include "lava_lamp.c"
+
+/* NOTE
+ * Headless benchmark for the circle sim, no window, no audio, no GL. Every run spawns the circles from the
+ * same seed and steps them at SIM_DT, so the checksum at the end only changes when the sim's math does.
+ *
+ * usage: bench [steps] [seed] [reorder steps] [PAIRS|FIELD]
+ *
+ * Without steps every circle count gets roughly the same amount of pair work, see BENCH_PAIR_BUDGET, also
+ * with the FIELD forces, which don't look at pairs at all, so there ns/pair shows how much cheaper they are.
+ * With reorder steps the circles are sorted into Morton order that often, like the game's sim does, compare
+ * against a run without to see what the order is worth. The checksums differ, the forces are summed in another order.
+ * JLIB_CPU_LEVEL=SSE2 or AVX2 runs the PAIRS kernel a narrower machine would pick, the checksum stays the same.
+ *
+ * The render benchmark draws the blob shader into an offscreen render texture for every resolution, circle
+ * count, pipeline and blend, and times it with GL_TIME_ELAPSED queries. It needs a GL context but never shows the
+ * window, so it runs fine on llvmpipe, e.g. LIBGL_ALWAYS_SOFTWARE=1 xvfb-run ./bench render.
+ * Every resolution also gets a GLOW row per glow level count, the count goes in the blend column. Those time
+ * the glow chain over the last blobs drawn.
+ *
+ * usage: bench render [out.csv] [resolutions] [circle counts] [frames]
+ *        bench render render.csv 640x360,1280x720 3,64,256 20
+ *
+ * Record runs the game's sim on a fixed timestep, SIM_HZ/fps steps per frame, draws every frame offscreen
+ * and captures it, see frame_capture.h. Nothing waits for the clock, so it renders as fast as the GPU and the
+ * writer allow. An out ending in a video extension is piped through ffmpeg, one starting with '|' is a command
+ * that gets raw RGBA frames on stdin, anything else is an image sequence pattern like "frames/%05d.png".
+ *
+ * usage: bench record [out] [seconds] [fps] [resolution] [lamps side]
+ *        bench record lamp.mp4 600 60 1920x1080
+ */
+
+
+/* * * * * * * * * * *
+ * macros
+ */
+
+#define BENCH_DEFAULT_SEED 0x1a7a1a3d
+#define BENCH_RNG_STREAM   7
+#define BENCH_PAIR_BUDGET  ((u64)1 << 28)
+#define BENCH_MIN_STEPS    8
+#define BENCH_MAX_STEPS    100000
+#define BENCH_WARMUP_STEPS 4
+#define BENCH_BOUNDS       ((Vector2){ 1000, 800 })
+
+#define RENDER_BENCH_DEFAULT_CSV_PATH "./render_bench.csv"
+#define RENDER_BENCH_DEFAULT_FRAMES   30
+#define RENDER_BENCH_WARMUP_FRAMES    3
+#define RENDER_BENCH_MAX_CONFIGS      16
+#define RENDER_BENCH_BUILD_TIMEOUT_NS BILLION(10ull)
+
+#define RECORD_DEFAULT_OUT     "./capture/record_%05d.qoi"
+#define RECORD_DEFAULT_SECONDS 10
+#define RECORD_DEFAULT_FPS     60
+#define RECORD_DEFAULT_WIDTH   1280
+#define RECORD_DEFAULT_HEIGHT  720
+#define RECORD_FFMPEG_COMMAND  "|ffmpeg -y -loglevel error -f rawvideo -pixel_format rgba -video_size %dx%d -framerate %d -i - -pix_fmt yuv420p \"%s\""
+
+
+/* * * * * * * * * * *
+ * structs
+ */
+
+typedef struct Bench_result {
+  int circles_count;
+  u64 steps;
+  u64 elapsed_ns;
+  u64 checksum;
+} Bench_result;
+
+typedef struct Render_bench_result {
+  int width;
+  int height;
+  int circles_count;
+  Blob_pipeline pipeline;
+  Blob_blend blend;
+  int frames;
+  f64 gpu_ms; /* negative when there are no timer queries */
+  f64 cpu_ms; /* submit to glFinish() */
+} Render_bench_result;
+
+
+/* * * * * * * * * * *
+ * globals
+ */
+
+Circle bench_circles[MAX_CIRCLES];
+Circle bench_warmup_circles[MAX_CIRCLES];
+u16 bench_handles[MAX_CIRCLES];
+Sim_field bench_field;
+
+int bench_circles_counts[] = { 3, 8, 16, 32, 64, 128, 256, 512, 1024, MAX_CIRCLES };
+
+char *blob_blend_names[] = {
+#define X(blend) #blend,
+  BLOB_BLENDS
+#undef X
+};
+
+Vector2 render_bench_default_resolutions[] = { { 640, 360 }, { 1280, 720 }, { 1920, 1080 } };
+int render_bench_default_circles_counts[] = { 3, 16, 64, 256, 1024 };
+
+Asset_stream render_bench_assets;
+Shader_manager render_bench_shaders;
+
+GPU_circles render_bench_gpu_circles;
+Vector2 render_bench_seeds[MAX_CIRCLES];
+
+Jump_flood render_bench_jump_flood;
+
+Glow render_bench_glow;
+
+char *record_video_extensions[] = { ".mp4", ".mkv", ".webm", ".mov" };
+
+Sim record_sim;
+Frame_capture record_capture;
+
+
+/* * * * * * * * * * *
+ * function headers
+ */
+
+void bench_spawn(Circle *circles, int circles_count, Vector2 bounds, u32 seed);
+u64  bench_checksum(Circle *circles, int circles_count);
+Bench_result bench_run(int circles_count, u64 steps, u32 seed, u64 reorder_steps, Sim_params params);
+int  bench_main(int argc, char **argv);
+int  render_bench_parse_list(char *arg, char *fmt, int per_item, void *out, int max);
+b32  render_bench_wait_for_shader(s32 program);
+Render_bench_result render_bench_run(Shader shader, Jump_flood *jf, RenderTexture2D target, GPU_circles *gc, int frames, u32 query);
+Render_bench_result render_bench_run_glow(Glow *glow, RenderTexture2D target, int frames, u32 query);
+int  render_bench_main(int argc, char **argv);
+int  record_main(int argc, char **argv);
+
+
+/* * * * * * * * * * *
+ * function bodies
+ */
+
+/* every attribute is filled for all circles at once, so the same seed gives the same lamp for any count prefix */
+void bench_spawn(Circle *circles, int circles_count, Vector2 bounds, u32 seed) {
+  Rng rng = rng_seed(seed, BENCH_RNG_STREAM);
+
+  scratch_scope() {
+    f32 *radii  = scratch_push_array_no_zero(f32, circles_count);
+    f32 *xs     = scratch_push_array_no_zero(f32, circles_count);
+    f32 *ys     = scratch_push_array_no_zero(f32, circles_count);
+    f32 *speeds = scratch_push_array_no_zero(f32, circles_count);
+    f32 *dirs   = scratch_push_array_no_zero(f32, 2*circles_count);
+
+    rng_fill_f32(&rng, radii, circles_count, 40, 150);
+    rng_fill_f32(&rng, xs, circles_count, 0, 1);
+    rng_fill_f32(&rng, ys, circles_count, 0, 1);
+    rng_fill_f32(&rng, speeds, circles_count, 300, 600);
+    rng_fill_unit_vec2(&rng, dirs, circles_count);
+
+    for(int i = 0; i < circles_count; i++) {
+      Circle *c = &circles[i];
+
+      f32 r = radii[i];
+      u32 color = rng_u32(&rng);
+
+      *c = (Circle) {
+        .radius = r,
+        .softness = 10.f,
+        .center = { r + xs[i]*(bounds.x - 2*r), r + ys[i]*(bounds.y - 2*r) },
+        .color = { (u8)color, (u8)(color >> 8), (u8)(color >> 16), 255 },
+        .vel = { dirs[2*i]*speeds[i], dirs[2*i + 1]*speeds[i] },
+        .friction = r*FRICTION_TO_RADIUS,
+        .mass = r*MASS_TO_RADIUS,
+        .temperature = ys[i],
+      };
+    }
+  }
+}
+
+/* FNV-1a over the raw bytes, any change in the sim's float math shows up here */
+u64 bench_checksum(Circle *circles, int circles_count) {
+  u64 result = 0xcbf29ce484222325ull;
+
+  u8 *bytes = (u8*)circles;
+  u64 size = sizeof(Circle)*circles_count;
+
+  for(u64 i = 0; i < size; i++) {
+    result ^= bytes[i];
+    result *= 0x100000001b3ull;
+  }
+
+  return result;
+}
+
+Bench_result bench_run(int circles_count, u64 steps, u32 seed, u64 reorder_steps, Sim_params params) {
+  Bench_result result = { .circles_count = circles_count, .steps = steps };
+
+  bench_spawn(bench_circles, circles_count, BENCH_BOUNDS, seed);
+
+  // NOTE warm the caches on a throwaway copy, so the measured run starts from the seeded state
+  memory_copy(bench_warmup_circles, bench_circles, sizeof(Circle)*circles_count);
+  field_reset(&bench_field);
+  for(int i = 0; i < BENCH_WARMUP_STEPS; i++) {
+    sim_step(bench_warmup_circles, circles_count, &bench_field, params, SIM_DT, BENCH_BOUNDS, 1);
+  }
+
+  field_reset(&bench_field);
+
+  for(int i = 0; i < circles_count; i++) {
+    bench_handles[i] = (u16)i;
+  }
+
+  u64 begin_ns = os_now_ns();
+
+  for(u64 i = 0; i < steps; i++) {
+    if(reorder_steps && i % reorder_steps == 0) {
+      circles_sort_morton(bench_circles, bench_handles, circles_count, SIM_REORDER_CELL);
+    }
+
+    sim_step(bench_circles, circles_count, &bench_field, params, SIM_DT, BENCH_BOUNDS, 1);
+  }
+
+  result.elapsed_ns = os_now_ns() - begin_ns;
+  result.checksum = bench_checksum(bench_circles, circles_count);
+
+  return result;
+}
+
+int bench_main(int argc, char **argv) {
+
+  u64 fixed_steps = 0;
+  u32 seed = BENCH_DEFAULT_SEED;
+  u64 reorder_steps = 0;
+  Sim_params params = SIM_PARAMS_DEFAULT;
+
+  if(argc > 1) {
+    fixed_steps = strtoull(argv[1], 0, 0);
+  }
+
+  if(argc > 2) {
+    seed = (u32)strtoul(argv[2], 0, 0);
+  }
+
+  if(argc > 3) {
+    reorder_steps = strtoull(argv[3], 0, 0);
+  }
+
+  if(argc > 4) {
+    for(Sim_forces forces = 0; forces < SIM_FORCES_MAX; forces++) {
+      if(!strcmp(argv[4], sim_forces_names[forces])) {
+        params.forces = forces;
+      }
+    }
+  }
+
+  printf("seed 0x%08x, sim dt %f, %s forces, reorder every %llu steps, cpu level %s\n",
+      seed, SIM_DT, sim_forces_names[params.forces], (unsigned long long)reorder_steps, cpu_level_names[cpu_level()]);
+  printf("%8s %8s %14s %12s %18s\n", "circles", "steps", "ns/step", "ns/pair", "checksum");
+
+  for(int i = 0; i < ARRLEN(bench_circles_counts); i++) {
+    int circles_count = bench_circles_counts[i];
+    u64 pairs = (u64)circles_count*(u64)(circles_count - 1);
+
+    u64 steps = fixed_steps;
+
+    if(!steps) {
+      steps = CLAMP_TOP(CLAMP_BOT(BENCH_PAIR_BUDGET / pairs, BENCH_MIN_STEPS), BENCH_MAX_STEPS);
+    }
+
+    Bench_result r = bench_run(circles_count, steps, seed, reorder_steps, params);
+
+    f64 ns_per_step = (f64)r.elapsed_ns / (f64)r.steps;
+    f64 ns_per_pair = ns_per_step / (f64)pairs;
+
+    printf("%8d %8llu %14.1f %12.3f %18llx\n",
+        r.circles_count, (unsigned long long)r.steps, ns_per_step, ns_per_pair, (unsigned long long)r.checksum);
+  }
+
+  return 0;
+}
+
+/* parses a comma separated list with sscanf, returns how many items it got */
+int render_bench_parse_list(char *arg, char *fmt, int per_item, void *out, int max) {
+  int result = 0;
+
+  for(char *item = arg; item && *item && result < max; ) {
+    int *dst = (int*)out + result*per_item;
+
+    if(per_item == 2 ? sscanf(item, fmt, &dst[0], &dst[1]) == 2 : sscanf(item, fmt, &dst[0]) == 1) {
+      result++;
+    }
+
+    item = strchr(item, ',');
+    if(item) item++;
+  }
+
+  return result;
+}
+
+/* the shader manager builds on update, and the sources stream in first */
+b32 render_bench_wait_for_shader(s32 program) {
+  u64 begin_ns = os_now_ns();
+
+  while(!shader_manager_generation(&render_bench_shaders, program)) {
+    if(os_now_ns() - begin_ns > RENDER_BENCH_BUILD_TIMEOUT_NS) {
+      return 0;
+    }
+
+    asset_stream_update(&render_bench_assets, ASSET_STREAM_DEFAULT_UPLOAD_BUDGET);
+    shader_manager_update(&render_bench_shaders);
+    os_sleep_ns(MILLION(1ull));
+  }
+
+  return 1;
+}
+
+/* jf is null for the loop pipeline, otherwise the jump flood passes are part of every timed frame */
+Render_bench_result render_bench_run(Shader shader, Jump_flood *jf, RenderTexture2D target, GPU_circles *gc, int frames, u32 query) {
+  Render_bench_result result = {
+    .width = target.texture.width,
+    .height = target.texture.height,
+    .circles_count = gc->circles_count,
+    .frames = frames,
+    .gpu_ms = -1,
+  };
+
+  GPU_circles_locs circles_locs = gpu_circles_locs(shader);
+  int k_loc = GetShaderLocation(shader, "k");
+  int nearest_tex_loc = GetShaderLocation(shader, "nearest_tex");
+  int gather_radius_loc = GetShaderLocation(shader, "gather_radius");
+  f32 k = BLOB_K_DEFAULT;
+  f32 gather_radius = k*BLOB_GATHER_RADIUS_PER_K;
+
+  u64 gpu_ns = 0;
+  u64 cpu_ns = 0;
+
+  for(int frame = -RENDER_BENCH_WARMUP_FRAMES; frame < frames; frame++) {
+    u64 begin_ns = os_now_ns();
+
+    if(query) {
+      glBeginQuery(GL_TIME_ELAPSED, query);
+    }
+
+    Texture2D nearest_tex = {0};
+
+    if(jf) {
+      nearest_tex = jump_flood_run(jf, gc, render_bench_seeds, result.width, result.height, 1);
+    }
+
+    deferloop((BeginTextureMode(target), ClearBackground(BLACK)), EndTextureMode()) {
+      deferloop(BeginShaderMode(shader), EndShaderMode()) {
+        gpu_circles_set_uniforms(gc, shader, circles_locs, (Vector2){ (f32)result.width, (f32)result.height }, 1);
+        SetShaderValue(shader, k_loc, &k, SHADER_UNIFORM_FLOAT);
+
+        if(nearest_tex.id) {
+          SetShaderValueTexture(shader, nearest_tex_loc, nearest_tex);
+          SetShaderValue(shader, gather_radius_loc, &gather_radius, SHADER_UNIFORM_FLOAT);
+        }
+
+        DrawRectangle(0, 0, result.width, result.height, WHITE);
+      }
+    }
+
+    if(query) {
+      glEndQuery(GL_TIME_ELAPSED);
+    }
+
+    glFinish();
+
+    u64 end_ns = os_now_ns();
+
+    if(frame < 0) {
+      continue;
+    }
+
+    cpu_ns += end_ns - begin_ns;
+
+    if(query) {
+      GLuint64 elapsed = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+      gpu_ns += elapsed;
+    }
+  }
+
+  result.cpu_ms = (f64)cpu_ns / (f64)frames / 1e6;
+
+  if(query) {
+    result.gpu_ms = (f64)gpu_ns / (f64)frames / 1e6;
+  }
+
+  return result;
+}
+
+/* blurs whatever is in target and adds it back on top, so run it after the blobs */
+Render_bench_result render_bench_run_glow(Glow *glow, RenderTexture2D target, int frames, u32 query) {
+  Render_bench_result result = {
+    .width = target.texture.width,
+    .height = target.texture.height,
+    .frames = frames,
+    .gpu_ms = -1,
+  };
+
+  Rectangle dst = { 0, 0, (f32)result.width, (f32)result.height };
+
+  u64 gpu_ns = 0;
+  u64 cpu_ns = 0;
+
+  for(int frame = -RENDER_BENCH_WARMUP_FRAMES; frame < frames; frame++) {
+    u64 begin_ns = os_now_ns();
+
+    if(query) {
+      glBeginQuery(GL_TIME_ELAPSED, query);
+    }
+
+    glow_run(glow, target.id, result.width, result.height);
+
+    deferloop(BeginTextureMode(target), EndTextureMode()) {
+      glow_composite(glow, dst, result.width, result.height);
+    }
+
+    if(query) {
+      glEndQuery(GL_TIME_ELAPSED);
+    }
+
+    glFinish();
+
+    u64 end_ns = os_now_ns();
+
+    if(frame < 0) {
+      continue;
+    }
+
+    cpu_ns += end_ns - begin_ns;
+
+    if(query) {
+      GLuint64 elapsed = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+      gpu_ns += elapsed;
+    }
+  }
+
+  result.cpu_ms = (f64)cpu_ns / (f64)frames / 1e6;
+
+  if(query) {
+    result.gpu_ms = (f64)gpu_ns / (f64)frames / 1e6;
+  }
+
+  return result;
+}
+
+int render_bench_main(int argc, char **argv) {
+  int result = 0;
+
+  char *csv_path = RENDER_BENCH_DEFAULT_CSV_PATH;
+
+  int resolutions[RENDER_BENCH_MAX_CONFIGS][2];
+  int resolutions_count = 0;
+
+  int circles_counts[RENDER_BENCH_MAX_CONFIGS];
+  int circles_counts_count = 0;
+
+  int frames = RENDER_BENCH_DEFAULT_FRAMES;
+
+  if(argc > 0) {
+    csv_path = argv[0];
+  }
+
+  if(argc > 1) {
+    resolutions_count = render_bench_parse_list(argv[1], "%dx%d", 2, resolutions, RENDER_BENCH_MAX_CONFIGS);
+  }
+
+  if(!resolutions_count) {
+    for(int i = 0; i < ARRLEN(render_bench_default_resolutions); i++) {
+      resolutions[i][0] = (int)render_bench_default_resolutions[i].x;
+      resolutions[i][1] = (int)render_bench_default_resolutions[i].y;
+    }
+    resolutions_count = ARRLEN(render_bench_default_resolutions);
+  }
+
+  if(argc > 2) {
+    circles_counts_count = render_bench_parse_list(argv[2], "%d", 1, circles_counts, RENDER_BENCH_MAX_CONFIGS);
+  }
+
+  if(!circles_counts_count) {
+    memory_copy(circles_counts, render_bench_default_circles_counts, sizeof(render_bench_default_circles_counts));
+    circles_counts_count = ARRLEN(render_bench_default_circles_counts);
+  }
+
+  if(argc > 3) {
+    frames = MAX(1, atoi(argv[3]));
+  }
+
+  FILE *csv = fopen(csv_path, "w");
+
+  if(!csv) {
+    TraceLog(LOG_ERROR, "can't open %s for writing", csv_path);
+    return 1;
+  }
+
+  // NOTE we only need the context, everything is drawn offscreen
+  SetConfigFlags(FLAG_WINDOW_HIDDEN);
+  InitWindow(64, 64, "lava lamp render bench");
+
+  /* timer queries are core since 3.3 */
+  u32 query = 0;
+  if(GLAD_GL_VERSION_3_3 || GLAD_GL_ARB_timer_query) {
+    glGenQueries(1, &query);
+  } else {
+    TraceLog(LOG_WARNING, "no timer queries, only cpu times will be reported");
+  }
+
+  asset_stream_init(&render_bench_assets);
+  shader_manager_init(&render_bench_shaders, &render_bench_assets, SHADER_CACHE_DIR);
+
+  s32 blob_shader_program = shader_manager_add(&render_bench_shaders, str8_lit(BLOB_VERT_PATH), str8_lit(BLOB_PIXEL_PATH));
+  s32 glow_shader_program = shader_manager_add(&render_bench_shaders, str8_lit(BLOB_VERT_PATH), str8_lit(GLOW_PIXEL_PATH));
+
+  gpu_circles_init(&render_bench_gpu_circles);
+  glow_init(&render_bench_glow);
+
+  for(Glow_pass pass = 0; pass < GLOW_PASS_MAX; pass++) {
+    s32 variant = 0;
+
+    scratch_scope() {
+      variant = shader_manager_variant(&render_bench_shaders, glow_shader_program, scratch_push_str8f("#define GLOW_PASS %i\n", pass));
+    }
+
+    if(render_bench_wait_for_shader(variant)) {
+      glow_set_shader(&render_bench_glow, pass, shader_manager_get(&render_bench_shaders, variant));
+    } else {
+      TraceLog(LOG_WARNING, "glow shader variant %i never built, skipping the glow runs", variant);
+    }
+  }
+
+  printf("%s | %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+  printf("%11s %8s %12s %16s %10s %10s\n", "resolution", "circles", "pipeline", "blend", "gpu ms", "cpu ms");
+
+  fprintf(csv, "renderer,width,height,circles,pipeline,blend,frames,gpu_ms,cpu_ms\n");
+
+  for(int res_i = 0; res_i < resolutions_count && !result; res_i++) {
+    int width = resolutions[res_i][0];
+    int height = resolutions[res_i][1];
+
+    RenderTexture2D target = LoadRenderTexture(width, height);
+
+    for(int count_i = 0; count_i < circles_counts_count && !result; count_i++) {
+      int circles_count = CLAMP_TOP(CLAMP_BOT(circles_counts[count_i], 1), MAX_CIRCLES);
+
+      bench_spawn(bench_circles, circles_count, (Vector2){ (f32)width, (f32)height }, BENCH_DEFAULT_SEED);
+
+      GPU_circles *gc = &render_bench_gpu_circles;
+      gpu_circles_clear_palette(gc);
+
+      for(int i = 0; i < circles_count; i++) {
+        u8 color = gpu_circles_color(gc, bench_circles[i].color);
+        gc->circles[i] = gpu_circle_pack(bench_circles[i], color, (Vector2){ (f32)width, (f32)height }, 1);
+        render_bench_seeds[i] = bench_circles[i].center;
+      }
+
+      gc->circles_count = circles_count;
+      gpu_circles_set_lamp(gc, 0, (Rectangle){ 0, 0, 1, 1 }, 0, circles_count);
+      gpu_circles_upload(gc);
+
+      /* AUTO is only a choice between the other two */
+      for(Blob_pipeline pipeline = BLOB_PIPELINE_LOOP; pipeline < BLOB_PIPELINE_MAX && !result; pipeline++) {
+        Blob_pass pass = pipeline == BLOB_PIPELINE_JUMP_FLOOD ? BLOB_PASS_JUMP_FLOOD_SHADE : BLOB_PASS_LOOP;
+        Jump_flood *jf = 0;
+
+        if(pass == BLOB_PASS_JUMP_FLOOD_SHADE) {
+          s32 step_variant = 0;
+
+          scratch_scope() {
+            step_variant = shader_manager_variant(&render_bench_shaders, blob_shader_program,
+                blob_shader_defines(0, 0, 0, BLOB_PASS_JUMP_FLOOD_STEP));
+          }
+
+          if(!render_bench_wait_for_shader(step_variant)) {
+            TraceLog(LOG_ERROR, "jump flood shader variant %i never built", step_variant);
+            result = 1;
+            break;
+          }
+
+          jf = &render_bench_jump_flood;
+          jump_flood_set_shader(jf, shader_manager_get(&render_bench_shaders, step_variant));
+        }
+
+        for(Blob_blend blend = 0; blend < BLOB_BLEND_MAX; blend++) {
+          s32 variant = 0;
+
+          scratch_scope() {
+            variant = shader_manager_variant(&render_bench_shaders, blob_shader_program,
+                blob_shader_defines(blend, BLOB_COLOR_MIX_SMOOTH, circles_count, pass));
+          }
+
+          if(!render_bench_wait_for_shader(variant)) {
+            TraceLog(LOG_ERROR, "blob shader variant %i never built", variant);
+            result = 1;
+            break;
+          }
+
+          Render_bench_result r = render_bench_run(shader_manager_get(&render_bench_shaders, variant), jf, target, gc, frames, query);
+          r.pipeline = pipeline;
+          r.blend = blend;
+
+          printf("%5dx%-5d %8d %12s %16s %10.3f %10.3f\n", r.width, r.height, r.circles_count,
+              blob_pipeline_names[r.pipeline], blob_blend_names[r.blend], r.gpu_ms, r.cpu_ms);
+
+          fprintf(csv, "\"%s\",%d,%d,%d,%s,%s,%d,%.4f,%.4f\n",
+              glGetString(GL_RENDERER), r.width, r.height, r.circles_count,
+              blob_pipeline_names[r.pipeline], blob_blend_names[r.blend], r.frames, r.gpu_ms, r.cpu_ms);
+        }
+      }
+    }
+
+    Glow *glow = &render_bench_glow;
+
+    if(!result && glow->shaders[GLOW_PASS_DOWN].id && glow->shaders[GLOW_PASS_UP].id) {
+      for(s32 levels = 1; levels <= GLOW_MAX_LEVELS; levels++) {
+        glow->levels = levels;
+
+        Render_bench_result r = render_bench_run_glow(glow, target, frames, query);
+
+        printf("%5dx%-5d %8s %12s %16d %10.3f %10.3f\n", r.width, r.height, "-", "GLOW", levels, r.gpu_ms, r.cpu_ms);
+
+        fprintf(csv, "\"%s\",%d,%d,0,GLOW,%d,%d,%.4f,%.4f\n",
+            glGetString(GL_RENDERER), r.width, r.height, levels, r.frames, r.gpu_ms, r.cpu_ms);
+      }
+    }
+
+    UnloadRenderTexture(target);
+  }
+
+  fclose(csv);
+
+  gpu_circles_close(&render_bench_gpu_circles);
+  jump_flood_close(&render_bench_jump_flood);
+  glow_close(&render_bench_glow);
+
+  shader_manager_close(&render_bench_shaders);
+  asset_stream_close(&render_bench_assets);
+
+  if(query) {
+    glDeleteQueries(1, &query);
+  }
+
+  CloseWindow();
+
+  return result;
+}
+
+int record_main(int argc, char **argv) {
+  int result = 0;
+
+  char *out = RECORD_DEFAULT_OUT;
+  f32 seconds = RECORD_DEFAULT_SECONDS;
+  int fps = RECORD_DEFAULT_FPS;
+  int resolution[2] = { RECORD_DEFAULT_WIDTH, RECORD_DEFAULT_HEIGHT };
+  int lamps_side = 1;
+
+  if(argc > 0) {
+    out = argv[0];
+  }
+
+  if(argc > 1) {
+    seconds = (f32)atof(argv[1]);
+  }
+
+  if(argc > 2) {
+    fps = CLAMP_BOT(atoi(argv[2]), 1);
+  }
+
+  if(argc > 3) {
+    render_bench_parse_list(argv[3], "%dx%d", 2, resolution, 1);
+  }
+
+  if(argc > 4) {
+    lamps_side = CLAMP_TOP(CLAMP_BOT(atoi(argv[4]), 1), LAMPS_SIDE_MAX);
+  }
+
+  int width = resolution[0];
+  int height = resolution[1];
+  int frames = (int)(seconds*(f32)fps);
+  Vector2 screen_size = { (f32)width, (f32)height };
+
+  char target[FRAME_CAPTURE_TARGET_MAX];
+  snprintf(target, sizeof(target), "%s", out);
+
+  char *extension = strrchr(out, '.');
+
+  for(int i = 0; extension && i < ARRLEN(record_video_extensions); i++) {
+    if(!strcmp(extension, record_video_extensions[i])) {
+      snprintf(target, sizeof(target), RECORD_FFMPEG_COMMAND, width, height, fps, out);
+    }
+  }
+
+  // NOTE we only need the context, everything is drawn offscreen
+  SetConfigFlags(FLAG_WINDOW_HIDDEN);
+  InitWindow(64, 64, "lava lamp record");
+
+  asset_stream_init(&render_bench_assets);
+  shader_manager_init(&render_bench_shaders, &render_bench_assets, SHADER_CACHE_DIR);
+
+  s32 blob_shader_program = shader_manager_add(&render_bench_shaders, str8_lit(BLOB_VERT_PATH), str8_lit(BLOB_PIXEL_PATH));
+
+  GPU_circles *gc = &render_bench_gpu_circles;
+  gpu_circles_init(gc);
+
+  Sim *sim = &record_sim;
+  sim->back = 0;
+  sim->middle = 1;
+  sim->front = 2;
+  sim->params = SIM_PARAMS_DEFAULT;
+  sim->rng = rng_seed(SIM_SEED, SIM_RNG_STREAM);
+  sim->lamps_side_requested = (u32)lamps_side;
+  sim_reset(sim, screen_size);
+
+  int lamp_circles_max = 0;
+  for(int l = 0; l < sim->lamps_count; l++) {
+    lamp_circles_max = MAX(lamp_circles_max, sim->lamps[l].count);
+  }
+
+  s32 variant = 0;
+
+  scratch_scope() {
+    variant = shader_manager_variant(&render_bench_shaders, blob_shader_program,
+        blob_shader_defines(BLOB_BLEND_SMIN_CUBIC, BLOB_COLOR_MIX_SMOOTH, lamp_circles_max, BLOB_PASS_LOOP));
+  }
+
+  RenderTexture2D frame_target = LoadRenderTexture(width, height);
+
+  if(!render_bench_wait_for_shader(variant)) {
+    TraceLog(LOG_ERROR, "blob shader variant %i never built", variant);
+    result = 1;
+  } else if(!frame_capture_begin(&record_capture, target, width, height)) {
+    result = 1;
+  }
+
+  Shader shader = shader_manager_get(&render_bench_shaders, variant);
+  GPU_circles_locs circles_locs = gpu_circles_locs(shader);
+  int k_loc = GetShaderLocation(shader, "k");
+  f32 k = BLOB_K_DEFAULT*lamp_scale(sim->lamps_side, screen_size);
+
+  u64 begin_ns = os_now_ns();
+
+  for(int frame = 0; frame < frames && !result; frame++) {
+    // NOTE like in the game, the state is one step ahead of the frame and the circles are drawn in between
+    u64 time = (u64)frame*SIM_HZ;
+    u64 step = time/(u64)fps + 1;
+    f32 alpha = (f32)(time % (u64)fps) / (f32)fps;
+
+    if(sim->step < step) {
+      while(sim->step < step) {
+        sim_step_lamps(sim, screen_size);
+      }
+
+      sim_publish(sim, 0);
+    }
+
+    Sim_state *state = sim_acquire(sim);
+
+    gpu_circles_pack_state(gc, state, alpha, screen_size, (Vector2){ 1, 1 }, 1, render_bench_seeds);
+    gpu_circles_upload(gc);
+
+    deferloop((BeginTextureMode(frame_target), ClearBackground(BLACK)), EndTextureMode()) {
+      deferloop(BeginShaderMode(shader), EndShaderMode()) {
+        gpu_circles_set_uniforms(gc, shader, circles_locs, screen_size, 1);
+        SetShaderValue(shader, k_loc, &k, SHADER_UNIFORM_FLOAT);
+        DrawRectangle(0, 0, width, height, WHITE);
+      }
+    }
+
+    frame_capture_frame(&record_capture, frame_target.id);
+
+    if(atomic_read(&record_capture.failed)) {
+      result = 1;
+    }
+  }
+
+  if(record_capture.active && !frame_capture_end(&record_capture)) {
+    result = 1;
+  }
+
+  f64 elapsed_s = (f64)(os_now_ns() - begin_ns) / 1e9;
+  f64 video_s = (f64)frames/(f64)fps;
+
+  if(!result) {
+    printf("%d frames of %dx%d, %.1f s of video in %.2f s, %.1fx real time\n",
+        frames, width, height, video_s, elapsed_s, video_s/MAX(elapsed_s, 1e-9));
+  }
+
+  UnloadRenderTexture(frame_target);
+  gpu_circles_close(gc);
+
+  shader_manager_close(&render_bench_shaders);
+  asset_stream_close(&render_bench_assets);
+
+  CloseWindow();
+
+  return result;
+}
+
+int main(int argc, char **argv) {
+  int result = 0;
+
+  context_init();
+
+  SetTraceLogLevel(LOG_WARNING);
+
+  if(argc > 1 && !strcmp(argv[1], "render")) {
+    result = render_bench_main(argc - 2, argv + 2);
+  } else if(argc > 1 && !strcmp(argv[1], "record")) {
+    result = record_main(argc - 2, argv + 2);
+  } else {
+    result = bench_main(argc, argv);
+  }
+
+  context_close();
+
+  return result;
+}
@@ -1,192 +1,303 @@
 #version 330 core
 
+// NOTE
+// The shader manager inserts the variant #defines right after the #version line, see game_blob_shader_variant().
+// The numbers have to match the order of BLOB_BLENDS, BLOB_COLOR_MIXES and BLOB_PASSES in lava_lamp.c.
+//
+// BLOB_PASS_LOOP shades every pixel against every circle. The jump flood pipeline splats one seed pixel per
+// circle, runs the STEP pass log2(size) times with a halving jump, which leaves the index of the nearest
+// circle in every pixel, and then the SHADE pass only blends the few circles it finds around the pixel.
+//
+// The target is a lamps_side x lamps_side grid of lamps. Every pass looks up the lamp of its pixel first and
+// only ever looks at the circles in that lamp's range, pixels outside of the lamp's rect are left empty.
+
+#define BLOB_BLEND_SMIN_CUBIC     0
+#define BLOB_BLEND_SMIN_QUADRATIC 1
+#define BLOB_BLEND_METABALL       2
+
+#define BLOB_COLOR_MIX_SMOOTH   0
+#define BLOB_COLOR_MIX_NEAREST  1
+#define BLOB_COLOR_MIX_WEIGHTED 2
+
+#define BLOB_PASS_LOOP             0
+#define BLOB_PASS_JUMP_FLOOD_STEP  1
+#define BLOB_PASS_JUMP_FLOOD_SHADE 2
+
+#ifndef BLOB_BLEND
+#define BLOB_BLEND BLOB_BLEND_SMIN_CUBIC
+#endif
+
+#ifndef BLOB_COLOR_MIX
+#define BLOB_COLOR_MIX BLOB_COLOR_MIX_SMOOTH
+#endif
+
+#ifndef BLOB_PASS
+#define BLOB_PASS BLOB_PASS_LOOP
+#endif
+
+// upper bound for the loop over a lamp's circles, the real count is still a uniform
+#ifndef BLOB_MAX_CIRCLES
+#define BLOB_MAX_CIRCLES 2048
+#endif
+
+#ifndef BLOB_SOFTNESS
+#define BLOB_SOFTNESS 1.8
+#endif
+
+#define BLOB_METABALL_THRESHOLD 0.8
+
+// have to match lava_lamp.c
+#define CIRCLES_TEX_WIDTH 64
+#define MAX_LAMPS 64
+
+// the shade pass looks at the nearest circle of the pixel and of three rings of 8 pixels around it, the
+// outer ring is at 3*gather_radius, which the game keeps at 6k, past that the cubic smin doesn't blend.
+// Metaballs have no cutoff, so with those the far circles are simply missing.
+#ifndef BLOB_GATHER_TAPS
+#define BLOB_GATHER_TAPS 25
+#endif
+
 in vec2 fragTexCoord;
 
 out vec4 finalColor;
 
-//uniform vec4 screen_rect;
 uniform float dt;
-uniform sampler2D circles_tex;
+uniform usampler2D circles_tex; // one RG32UI texel per circle, see GPU_circle in lava_lamp.c
+uniform sampler2D palette_tex;
+uniform vec2 target_size;       // the centers are unorm, this scales them to pixels
+uniform float render_scale;     // and this the radii, below 1 with dynamic resolution on
 uniform int circles_count;
+uniform float k; // blend radius, the HUD has a slider for it
+
+uniform int lamps_side;
+uniform vec4 lamp_rects[MAX_LAMPS];   // unorm x, y, w, h of the target, y down like the screen
+uniform ivec2 lamp_ranges[MAX_LAMPS]; // first circle and count
+
+uniform sampler2D nearest_tex; // jump flood passes, circle index + 1 in rg, 0 means no circle
+uniform int jump;              // step pass
+uniform float gather_radius;   // shade pass
 
 struct Circle {
   vec2 center;
   float radius;
-  float softness;
   vec4 color;
 };
 
 Circle get_circle(int i) {
-  vec4 a = texelFetch(circles_tex, ivec2(i * 2, 0), 0);
-  vec4 b = texelFetch(circles_tex, ivec2(i * 2 + 1, 0), 0);
+  uvec2 t = texelFetch(circles_tex, ivec2(i % CIRCLES_TEX_WIDTH, i / CIRCLES_TEX_WIDTH), 0).xy;
 
   Circle c;
-  //c.center = (a.xy - screen_rect.xy) / screen_rect.zw;
-  //c.radius = a.z / screen_rect.z;
-  //c.softness = a.w / screen_rect.z;
-  //c.color = b;
-
-  c.center = a.xy;
-  c.radius = a.z;
-  c.softness = a.w;
-  c.color = b;
+  c.center = vec2(float(t.x & 0xffffu), float(t.x >> 16)) * (1.0/65535.0) * target_size;
+  c.radius = float(t.y & 0xffffu) * (1.0/16.0) * render_scale;
+  c.color = texelFetch(palette_tex, ivec2(int(t.y >> 24), 0), 0);
 
   return c;
 }
 
-//vec4 sdf_s_min(vec4 a, vec4 b, float k) {
-//    k *= 8.0;
-//    float h = max( k-abs(a.x-b.x), 0.0 )/(2.0*k);
-//    return vec4( min(a.x,b.x)-h*h*k,
-//                 mix(a.yz,b.yz,(a.x<b.x)?h:1.0-h), min(a.w, b.w) );
-///*
-//    k *= 4.0;
-//    float h = max( k-abs(a.x-b.x), 0.0 )/k;
-//    float m = h*h*k*(1.0/4.0);
-//    float n = h*(1.0/2.0);
-//    return (a.x<b.x) ? vec3(a.x-m, mix(a.yz, b.yz, n) ): 
-//                       vec3(b.x-m, mix(a.yz, b.yz, 1.0-n) );
-//*/                       
-//}
-
-// cubic polynomial
-//float smin( float a, float b, float k )
-//{
-//    k *= 6.0;
-//    float h = max( k-abs(a-b), 0.0 )/k;
-//    return min(a,b) - h*h*h*k*(1.0/6.0);
-//}
-
-// cubic polynomial
-vec2 smin(float a, float b, float k) {
-    float h = 1.0 - min( abs(a-b)/(6.0*k), 1.0 );
-    float w = h*h*h;
-    float m = w*0.5;
-    float s = w*k; 
-    return (a<b) ? vec2(a-s,m) : vec2(b-s,1.0-m);
-}
+struct Lamp {
+  ivec2 range;
+  bool inside;
+};
+
+Lamp get_lamp(vec2 frag_coord) {
+  vec2 p = frag_coord / target_size;
+  p.y = 1.0 - p.y;
 
-float circle_sdf(vec2 p, Circle circle) {
+  ivec2 cell = clamp(ivec2(p*float(lamps_side)), ivec2(0), ivec2(lamps_side - 1));
+  int i = cell.y*lamps_side + cell.x;
+  vec4 rect = lamp_rects[i];
 
-  vec2 center = circle.center;
-  float radius = circle.radius;
-  float softness = circle.softness;
+  Lamp lamp;
+  lamp.range = lamp_ranges[i];
+  lamp.inside = all(greaterThanEqual(p, rect.xy)) && all(lessThan(p, rect.xy + rect.zw));
 
-  float dist = distance(p, center) - radius;
+  return lamp;
+}
+
+bool lamp_has(Lamp lamp, int i) {
+  return i >= lamp.range.x && i < lamp.range.x + lamp.range.y;
+}
 
-  float t = smoothstep(radius + softness, radius - softness, dist);
+int decode_index(vec4 t) {
+  return int(t.r*255.0 + 0.5) + int(t.g*255.0 + 0.5)*256 - 1;
+}
 
-  return t;
+vec4 encode_index(int i) {
+  i += 1;
+  return vec4(float(i & 255)/255.0, float(i >> 8)/255.0, 0.0, 1.0);
 }
 
+#if BLOB_PASS == BLOB_PASS_JUMP_FLOOD_STEP
+
 void main() {
-  vec2 frag_coord = gl_FragCoord.xy;
+  ivec2 p = ivec2(gl_FragCoord.xy);
+  ivec2 size = textureSize(nearest_tex, 0);
 
-  Circle c0 = get_circle(0);
-  float softness = 1.8;
-  //softness += (softness*0.4)*exp(sin(dt*1.6)+1);
-  float k = 65.6;
-  vec4 color = c0.color;
-  float d = 1e9;
+  Lamp lamp = get_lamp(gl_FragCoord.xy);
 
-  for(int i = 0; i < circles_count; i++) {
-    Circle c = get_circle(i);
+  int best = -1;
+  float best_d = 1e9;
 
-    //float radius = c.radius + (c.radius*0.1)*(sin(dt*3.0)+1);
-    float radius = c.radius;
-    float di = length(frag_coord - c.center) - radius;
-    vec2 result = smin(d, di, k);
-    d = result.x;
-    float blend = result.y;
+  for(int y = -1; y <= 1; y++) {
+    for(int x = -1; x <= 1; x++) {
+      ivec2 q = p + ivec2(x, y)*jump;
+
+      if(any(lessThan(q, ivec2(0))) || any(greaterThanEqual(q, size))) continue;
+
+      int i = decode_index(texelFetch(nearest_tex, q, 0));
+
+      if(i < 0 || i >= circles_count || i == best || !lamp_has(lamp, i)) continue;
+
+      Circle c = get_circle(i);
 
-    color  = mix(color, c.color, blend);
+      // distance to the edge, so a big circle keeps the pixels it covers
+      float d = length(gl_FragCoord.xy - c.center) - c.radius;
 
+      if(d < best_d) {
+        best_d = d;
+        best = i;
+      }
+    }
   }
 
-  float alpha = 1.0 - smoothstep(0.0, softness, d);
-  finalColor = vec4(color.rgb, alpha);
+  finalColor = encode_index(best);
+}
 
-  //Circle c1 = get_circle(0);
-  //Circle c2 = get_circle(1);
+#else
 
-  //float d1 = length(frag_coord - c1.center) - c1.radius;
-  //float d2 = length(frag_coord - c2.center) - c2.radius;
+// smooth minimum, y is the blend factor towards b
+vec2 smin(float a, float b, float k) {
+#if BLOB_BLEND == BLOB_BLEND_SMIN_QUADRATIC
+  float h = 1.0 - min( abs(a-b)/(4.0*k), 1.0 );
+  float w = h*h;
+  float m = w*0.5;
+  float s = w*k;
+#else
+  float h = 1.0 - min( abs(a-b)/(6.0*k), 1.0 );
+  float w = h*h*h;
+  float m = w*0.5;
+  float s = w*k;
+#endif
+  return (a<b) ? vec2(a-s,m) : vec2(b-s,1.0-m);
+}
 
-  //float d = smin(d1, d2, 13.3);
-  //float softness = 15.0;
-  //float alpha = 1.0 - smoothstep(0.0, softness, d);
+void main() {
+  vec2 frag_coord = gl_FragCoord.xy;
 
-  //vec2 dir = c2.center - c1.center;
-  //vec3 color = mix(c1.color.rgb, c2.color.rgb, 0.7);
+  Lamp lamp = get_lamp(frag_coord);
 
-  //finalColor = vec4(vec3(0.4, 0.8, 0.2), alpha);
-  //finalColor = vec4(color, alpha);
+  if(!lamp.inside) {
+    finalColor = vec4(0.0);
+    return;
+  }
 
-  //vec4 result = vec4(1.0);
+#if BLOB_PASS == BLOB_PASS_JUMP_FLOOD_SHADE
+  // kept sorted, so the circles are blended in the same order as the loop pass blends them
+  int candidates[BLOB_GATHER_TAPS];
+  int candidates_count = 0;
 
-  //for(int i = 0; i < circles_count; i++) {
-  //  Circle c = get_circle(i);
+  ivec2 size = textureSize(nearest_tex, 0);
 
-  //  float a = circle_sdf(gl_FragCoord.xy, c.center, c.radius, c.softness);
+  for(int tap = 0; tap < BLOB_GATHER_TAPS; tap++) {
+    vec2 offset = vec2(0.0);
+    if(tap > 0) {
+      float ring = float((tap - 1) / 8 + 1);
+      float angle = float(tap - 1) * (6.2831853 / 8.0) + (ring - 1.0) * (3.1415927 / 8.0);
+      offset = ring * gather_radius * vec2(cos(angle), sin(angle));
+    }
 
-  //  vec4 color = vec4(c.color.rgb * a * c.color.a, a * c.color.a);
-  //  result = sdf_s_min(result, color, 0.05);
+    ivec2 q = clamp(ivec2(frag_coord + offset), ivec2(0), size - 1);
 
-  //}
+    int i = decode_index(texelFetch(nearest_tex, q, 0));
 
-  //finalColor = result;
+    bool seen = i < 0 || i >= circles_count || !lamp_has(lamp, i);
+    for(int j = 0; j < candidates_count; j++) {
+      seen = seen || candidates[j] == i;
+    }
 
-  /*
-  vec4 result = vec4(0.0);
-  float field = 0.0;
+    if(seen) continue;
 
-  for(int i = 0; i < circles_count; i++) {
-    Circle c = get_circle(i);
-    float dist = distance(gl_FragCoord.xy, c.center);
-    float influence;
-    //influence = c.radius / dist;
-    influence = pow(c.radius, 2.0) / (dist*dist);
-    field += influence;
-    result += c.color * influence;
-  }
+    int j = candidates_count;
+    for(; j > 0 && candidates[j - 1] > i; j--) {
+      candidates[j] = candidates[j - 1];
+    }
 
-  float threshold = 0.8;
-  float mask = smoothstep(threshold - 0.04, threshold + 0.04, field);
-  finalColor = vec4(result.rgb / field, 1.0) * mask;
-  */
+    candidates[j] = i;
+    candidates_count++;
+  }
 
-  //vec2 center = vec2(0.5, 0.5);
-  //float radius = 0.25;
-  //float softness = 0.01;
-  //float alpha = circle_sdf(fragTexCoord, center, radius, softness);
-  //finalColor = vec4(1.0, 0.0, 0.0, alpha);  // Red circle with alpha blend
+#define LOOP_MAX      BLOB_GATHER_TAPS
+#define LOOP_COUNT    candidates_count
+#define LOOP_INDEX(n) candidates[n]
+#else
+#define LOOP_MAX      BLOB_MAX_CIRCLES
+#define LOOP_COUNT    lamp.range.y
+#define LOOP_INDEX(n) (lamp.range.x + (n))
+#endif
+
+  vec4 color = vec4(0.0);
+  if(LOOP_COUNT > 0) {
+    color = get_circle(LOOP_INDEX(0)).color;
+  }
 
-  /*
-  vec4 result = vec4(0.0);
+#if BLOB_BLEND == BLOB_BLEND_METABALL
+  float field = 0.0;
+#else
+  float d = 1e9;
+#endif
 
-  Circle c = get_circle(0);
+#if BLOB_COLOR_MIX == BLOB_COLOR_MIX_NEAREST
+  float nearest = 1e9;
+#elif BLOB_COLOR_MIX == BLOB_COLOR_MIX_WEIGHTED
+  vec4 color_sum = vec4(0.0);
+  float weight_sum = 0.0;
+#endif
 
-  float a = circle_sdf(gl_FragCoord.xy, c.center, c.radius, c.softness);
+  for(int n = 0; n < LOOP_MAX; n++) {
+    if(n >= LOOP_COUNT) break;
 
-  result.rgb += c.color.rgb * a * c.color.a;
-  result.a += a * c.color.a;
+    Circle c = get_circle(LOOP_INDEX(n));
 
-  finalColor = result;
-  */
-  /*
-     vec4 result = vec4(0.0);
+    float dist = length(frag_coord - c.center);
+    float di = dist - c.radius;
 
-     for(int i = 0; i < circles_count; i++) {
-     Circle c = get_circle(i);
+#if BLOB_BLEND == BLOB_BLEND_METABALL
+    float influence = (c.radius*c.radius) / max(dist*dist, 1e-4);
+    field += influence;
+    // running weighted average of the colors
+    float blend = influence / field;
+#else
+    vec2 result = smin(d, di, k);
+    d = result.x;
+    float blend = result.y;
+#endif
+
+#if BLOB_COLOR_MIX == BLOB_COLOR_MIX_SMOOTH
+    color = mix(color, c.color, blend);
+#elif BLOB_COLOR_MIX == BLOB_COLOR_MIX_NEAREST
+    color = mix(color, c.color, step(di, nearest));
+    nearest = min(nearest, di);
+#elif BLOB_COLOR_MIX == BLOB_COLOR_MIX_WEIGHTED
+    float weight = exp(-max(di, 0.0) / k);
+    color_sum += c.color * weight;
+    weight_sum += weight;
+#endif
 
-     float a = circle_sdf(fragTexCoord, c.center, c.radius, c.softness);
+  }
 
-     result.rgb += c.color.rgb * a * c.color.a;
-     result.a += a * c.color.a;
+#if BLOB_COLOR_MIX == BLOB_COLOR_MIX_WEIGHTED
+  color = color_sum / max(weight_sum, 1e-6);
+#endif
 
-     }
+#if BLOB_BLEND == BLOB_BLEND_METABALL
+  float alpha = smoothstep(BLOB_METABALL_THRESHOLD - 0.04, BLOB_METABALL_THRESHOLD + 0.04, field);
+#else
+  // in screen pixels like the radii, so the edge doesn't get wider as dynamic resolution lowers the scale
+  float alpha = 1.0 - smoothstep(0.0, BLOB_SOFTNESS * render_scale, d);
+#endif
 
-     finalColor = result;
-   */
+  finalColor = vec4(color.rgb, alpha);
 
 }
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef JLIB_CPU_H
+#define JLIB_CPU_H
+
+
+#include "basic.h"
+
+
+// NOTE
+// Runtime dispatch, so one build runs well on every x86-64 machine from an old Atom up.
+//
+// The build only assumes the x86-64 baseline, which always has SSE2. The kernels that are worth it get
+// compiled again for the wider levels by putting CPU_TARGET_AVX2 or CPU_TARGET_AVX512 on a copy of them,
+// which changes the code generated for that one function and nothing else, and callers go through a
+// function pointer that picks the copy for cpu_level() the first time it's called, see str8_find().
+//
+// cpu_level() asks cpuid what the CPU has and xgetbv whether the OS saves the wider registers, a CPU with
+// AVX2 under an OS that doesn't know about it is still SSE2. AVX512 means F and BW, the byte compares
+// the string kernels use are BW.
+//
+// The JLIB_CPU_LEVEL environment variable caps the level, e.g. JLIB_CPU_LEVEL=SSE2 runs the code an old
+// Atom would. Anything that isn't x86-64 built with clang or gcc, wasm included, is SCALAR.
+
+#if (defined(__x86_64__) || defined(_M_X64)) && (COMPILER_CLANG || COMPILER_GCC)
+# define CPU_X64 1
+# define CPU_TARGET_AVX2   __attribute__((target("avx2")))
+# define CPU_TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512bw")))
+# include <immintrin.h>
+#endif
+
+#define CPU_LEVELS \
+  X(SCALAR)        \
+  X(SSE2)          \
+  X(AVX2)          \
+  X(AVX512)        \
+
+typedef enum Cpu_level {
+  CPU_LEVEL_INVALID = -1,
+#define X(level) CPU_LEVEL_##level,
+  CPU_LEVELS
+#undef X
+    CPU_LEVEL_MAX,
+} Cpu_level;
+
+extern char *cpu_level_names[CPU_LEVEL_MAX];
+
+Cpu_level cpu_level(void);
+
+#endif
+
+
+#if defined(JLIB_CPU_IMPL) != defined(_UNITY_BUILD_)
+
+#ifdef _UNITY_BUILD_
+#define JLIB_CPU_IMPL
+#endif
+
+#if CPU_X64
+#include <cpuid.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+char *cpu_level_names[CPU_LEVEL_MAX] = {
+#define X(level) #level,
+  CPU_LEVELS
+#undef X
+};
+
+global Cpu_level cpu_level_ = CPU_LEVEL_INVALID;
+
+internal Cpu_level cpu_detect_(void) {
+  Cpu_level result = CPU_LEVEL_SCALAR;
+
+#if CPU_X64
+  result = CPU_LEVEL_SSE2;
+
+  u32 a, b, c, d;
+
+  if(__get_cpuid(1, &a, &b, &c, &d)) {
+    b32 osxsave = (c >> 27) & 1;
+    b32 avx = (c >> 28) & 1;
+
+    if(osxsave && avx) {
+      u32 xcr0_lo, xcr0_hi;
+      __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+
+      /* SSE and AVX state, and for AVX-512 the opmask and both halves of the zmm registers */
+      b32 ymm_saved = (xcr0_lo & 0x06) == 0x06;
+      b32 zmm_saved = (xcr0_lo & 0xe6) == 0xe6;
+
+      if(ymm_saved && __get_cpuid_count(7, 0, &a, &b, &c, &d)) {
+        b32 avx2 = (b >> 5) & 1;
+        b32 avx512f = (b >> 16) & 1;
+        b32 avx512bw = (b >> 30) & 1;
+
+        if(avx2) {
+          result = CPU_LEVEL_AVX2;
+
+          if(zmm_saved && avx512f && avx512bw) {
+            result = CPU_LEVEL_AVX512;
+          }
+        }
+      }
+    }
+  }
+#endif
+
+  char *cap = getenv("JLIB_CPU_LEVEL");
+
+  if(cap) {
+    for(Cpu_level level = 0; level < result; level++) {
+      if(!strcmp(cap, cpu_level_names[level])) {
+        result = level;
+        break;
+      }
+    }
+  }
+
+  return result;
+}
+
+/* the first call detects, every thread that races it gets the same answer */
+Cpu_level cpu_level(void) {
+  Cpu_level result = atomic_read(&cpu_level_);
+
+  if(result == CPU_LEVEL_INVALID) {
+    result = cpu_detect_();
+    atomic_write(&cpu_level_, result);
+  }
+
+  return result;
+}
+
+#endif
@@ -1,62 +1,344 @@
 #include "raylib.h"
 #include "basic.h"
+#include "arena.h"
+#include "str.h"
+#include "context.h"
+#include "os.h"
 #include <dlfcn.h>
 
+#if defined(OS_LINUX)
+#include <sys/inotify.h>
+#include <poll.h>
+#endif
+
+
+/* * * * * * * * * * *
+ * macros
+ */
+
+#define WATCHER_MAX_CHANGED_FILES 32
+
+#define MODULE_COPY_PATH_FMT GAME_MODULE_PATH ".%u"
+
+
+/* * * * * * * * * * *
+ * structs
+ */
 
 typedef void* (*Module_proc)(void *);
+typedef void  (*Module_file_proc)(void *, char *);
+
+typedef struct Module Module;
+struct Module {
+  void *handle;
+  u32 copy_index;
+
+  Module_proc init;
+  Module_proc close;
+  Module_proc main;
+  Module_proc unload_assets;
+  Module_proc load_assets;
+  Module_file_proc reload_file; /* optional */
+};
+
+typedef struct Watcher Watcher;
+struct Watcher {
+  /* set by the watcher thread, the main loop only ever does an atomic load per frame */
+  u32 module_changed;
+  u32 files_changed;
+
+  OS_handle mutex;
+  char changed_files[WATCHER_MAX_CHANGED_FILES][256];
+  s32 changed_files_count;
+
+#if defined(OS_LINUX)
+  OS_handle thread;
+  int inotify_fd;
+  int wake_pipe[2];
+#else
+  s64 module_modtime;
+#endif
+};
+
+
+/* * * * * * * * * * *
+ * globals
+ */
+
+/* directories with things worth reloading, the module lives in the first one */
+char *watch_dirs[] = {
+  ".",
+  "./aseprite",
+};
+
+
+/* * * * * * * * * * *
+ * function bodies
+ */
+
+/* NOTE
+ * dlopen() the module from a fresh copy each time. The copy is made after the linker has closed the file, so
+ * we never map a half written module, and since the path is new every time dlopen() can't hand back the old
+ * handle either.
+ */
+b32 module_load(Module *module, u32 copy_index) {
+  b32 result = 0;
+
+  char *copy_path = scratch_push_cstrf(MODULE_COPY_PATH_FMT, copy_index);
+
+  int size = 0;
+  u8 *data = LoadFileData(GAME_MODULE_PATH, &size);
+
+  if(!data) {
+    return result;
+  }
+
+  b32 saved = SaveFileData(copy_path, data, size);
+  UnloadFileData(data);
+
+  if(!saved) {
+    return result;
+  }
+
+  void *handle = dlopen(copy_path, RTLD_NOW);
+
+  if(!handle) {
+    TraceLog(LOG_ERROR, "failed to load module code: %s", dlerror());
+    os_remove_file(str8_cstr(copy_path));
+    return result;
+  }
+
+  *module = (Module) {
+    .handle         = handle,
+    .copy_index     = copy_index,
+    .init           = (Module_proc)dlsym(handle, "module_init"),
+    .close          = (Module_proc)dlsym(handle, "module_close"),
+    .main           = (Module_proc)dlsym(handle, "module_main"),
+    .unload_assets  = (Module_proc)dlsym(handle, "module_unload_assets"),
+    .load_assets    = (Module_proc)dlsym(handle, "module_load_assets"),
+    .reload_file    = (Module_file_proc)dlsym(handle, "module_reload_file"),
+  };
+
+  result = 1;
+
+  return result;
+}
+
+void module_unload(Module *module) {
+  if(dlclose(module->handle)) {
+    TraceLog(LOG_WARNING, "failed to close module code: %s", dlerror());
+  }
+
+  os_remove_file(str8_cstr(scratch_push_cstrf(MODULE_COPY_PATH_FMT, module->copy_index)));
+
+  memory_zero(module, sizeof(*module));
+}
+
+void watcher_push_changed_file(Watcher *watcher, char *path) {
+  os_mutex_scope(watcher->mutex) {
+    b32 found = 0;
+
+    for(s32 i = 0; i < watcher->changed_files_count; i++) {
+      if(!strcmp(watcher->changed_files[i], path)) {
+        found = 1;
+        break;
+      }
+    }
+
+    if(!found && watcher->changed_files_count < WATCHER_MAX_CHANGED_FILES) {
+      snprintf(watcher->changed_files[watcher->changed_files_count++], sizeof(watcher->changed_files[0]), "%s", path);
+    }
+  }
+
+  atomic_write(&watcher->files_changed, 1);
+}
+
+#if defined(OS_LINUX)
+
+void watcher_thread(void *arg) {
+  Watcher *watcher = arg;
+
+  int wds[ARRLEN(watch_dirs)];
+  for(int i = 0; i < ARRLEN(watch_dirs); i++) {
+    wds[i] = inotify_add_watch(watcher->inotify_fd, watch_dirs[i], IN_CLOSE_WRITE | IN_MOVED_TO);
+  }
+
+  const char *module_name = GetFileName(GAME_MODULE_PATH);
+  int module_name_len = (int)strlen(module_name);
+
+  u8 buf[KB(4)] __attribute__((aligned(__alignof__(struct inotify_event))));
 
+  for(;;) {
+    struct pollfd fds[2] = {
+      { .fd = watcher->inotify_fd, .events = POLLIN },
+      { .fd = watcher->wake_pipe[0], .events = POLLIN },
+    };
+
+    if(poll(fds, ARRLEN(fds), -1) < 0 || (fds[1].revents & POLLIN)) {
+      break;
+    }
+
+    ssize_t len = read(watcher->inotify_fd, buf, sizeof(buf));
+
+    if(len <= 0) {
+      continue;
+    }
+
+    for(u8 *p = buf; p < buf + len; p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len) {
+      struct inotify_event *event = (struct inotify_event*)p;
+
+      if(!event->len) {
+        continue;
+      }
+
+      int dir = -1;
+      for(int i = 0; i < ARRLEN(watch_dirs); i++) {
+        if(wds[i] == event->wd) {
+          dir = i;
+          break;
+        }
+      }
+
+      if(dir < 0) {
+        continue;
+      }
+
+      if(dir == 0 && !strncmp(event->name, module_name, module_name_len)) {
+        /* the numbered copies are ours, ignore them */
+        if(event->name[module_name_len] == 0) {
+          atomic_write(&watcher->module_changed, 1);
+        }
+      } else {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%s", watch_dirs[dir], event->name);
+        watcher_push_changed_file(watcher, path);
+      }
+    }
+  }
+}
+
+b32 watcher_init(Watcher *watcher) {
+  memory_zero(watcher, sizeof(*watcher));
+
+  watcher->inotify_fd = inotify_init1(IN_CLOEXEC);
+
+  if(watcher->inotify_fd < 0 || pipe(watcher->wake_pipe) < 0) {
+    return 0;
+  }
+
+  watcher->mutex = os_mutex_alloc();
+  watcher->thread = os_thread_launch(watcher_thread, watcher);
+
+  return 1;
+}
+
+void watcher_close(Watcher *watcher) {
+  (void)!write(watcher->wake_pipe[1], "", 1);
+  os_thread_join(watcher->thread);
+
+  close(watcher->wake_pipe[0]);
+  close(watcher->wake_pipe[1]);
+  close(watcher->inotify_fd);
+  os_mutex_release(watcher->mutex);
+}
+
+/* the thread does all the work */
+void watcher_poll(Watcher *watcher) {
+}
+
+#else
+
+/* NOTE no inotify here, fall back to checking the module's modtime every frame */
+b32 watcher_init(Watcher *watcher) {
+  memory_zero(watcher, sizeof(*watcher));
+  watcher->mutex = os_mutex_alloc();
+  watcher->module_modtime = GetFileModTime(GAME_MODULE_PATH);
+  return 1;
+}
+
+void watcher_close(Watcher *watcher) {
+  os_mutex_release(watcher->mutex);
+}
+
+void watcher_poll(Watcher *watcher) {
+  s64 modtime = GetFileModTime(GAME_MODULE_PATH);
+
+  if(watcher->module_modtime != modtime) {
+    watcher->module_modtime = modtime;
+
+    // NOTE no close event to wait for, give the linker a moment to finish writing
+    WaitTime(0.17f);
+    atomic_write(&watcher->module_changed, 1);
+  }
+}
+
+#endif
 
 int main(void) {
 
-  //context_init();
+  context_init();
+
+  Watcher watcher;
+  if(!watcher_init(&watcher)) {
+    TraceLog(LOG_ERROR, "failed to start file watcher");
+    return 1;
+  }
 
-  void *module = dlopen(GAME_MODULE_PATH, RTLD_NOW);
-  s64 module_modtime = GetFileModTime(GAME_MODULE_PATH);
+  u32 copy_index = 0;
+  Module module = {0};
 
-  if(module) {
+  if(module_load(&module, copy_index++)) {
     TraceLog(LOG_INFO, "successfully loaded module code");
   } else {
     TraceLog(LOG_INFO, "failed to load module code");
     return 1;
   }
 
-  Module_proc module_init_proc            = (Module_proc)dlsym(module, "module_init");
-  Module_proc module_close_proc           = (Module_proc)dlsym(module, "module_close");
-  Module_proc module_main_proc            = (Module_proc)dlsym(module, "module_main");
-  Module_proc module_unload_assets_proc   = (Module_proc)dlsym(module, "module_unload_assets");
-  Module_proc module_load_assets_proc     = (Module_proc)dlsym(module, "module_load_assets");
+  void *state = module.init(0);
+
+  while(module.main(state)) {
 
-  void *state = module_init_proc(0);
+    scratch_clear();
 
-  while(module_main_proc(state)) {
+    watcher_poll(&watcher);
+
+    if(atomic_read(&watcher.module_changed)) {
+      atomic_write(&watcher.module_changed, 0);
 
-    s64 modtime = GetFileModTime(GAME_MODULE_PATH);
-    if(module_modtime != modtime) {
       TraceLog(LOG_INFO, "reloading module code");
-      module_modtime = modtime;
 
-      WaitTime(0.17f);
-      if(dlclose(module)) {
-        TraceLog(LOG_ERROR, "failed to reload module code");
-        return 1;
-      }
+      Module new_module = {0};
 
-      module = dlopen(GAME_MODULE_PATH, RTLD_NOW);
+      // NOTE keep running the old code if the new module doesn't load
+      if(module_load(&new_module, copy_index++)) {
+        // NOTE unload with the old code, the asset stream's worker thread is running it
+        module.unload_assets(state);
+        module_unload(&module);
 
-      module_init_proc  = (Module_proc)dlsym(module, "module_init");
-      module_close_proc = (Module_proc)dlsym(module, "module_close");
-      module_main_proc  = (Module_proc)dlsym(module, "module_main");
+        module = new_module;
+        module.load_assets(state);
+      }
+    }
 
-      module_unload_assets_proc = (Module_proc)dlsym(module, "module_unload_assets");
-      module_load_assets_proc   = (Module_proc)dlsym(module, "module_load_assets");
+    if(atomic_read(&watcher.files_changed)) {
+      atomic_write(&watcher.files_changed, 0);
 
-      module_unload_assets_proc(state);
-      module_load_assets_proc(state);
+      os_mutex_scope(watcher.mutex) {
+        for(s32 i = 0; i < watcher.changed_files_count; i++) {
+          if(module.reload_file) {
+            module.reload_file(state, watcher.changed_files[i]);
+          }
+        }
+        watcher.changed_files_count = 0;
+      }
     }
 
   }
 
-  module_close_proc(state);
+  module.close(state);
+  module_unload(&module);
+
+  watcher_close(&watcher);
 
   return 0;
 }
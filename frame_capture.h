@@ -0,0 +1,385 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+
+#include "basic.h"
+#include "str.h"
+#include "os.h"
+
+
+/* NOTE
+ *
+ * Reads frames back off the GPU without stalling the render thread and writes them out on a worker thread.
+ *
+ * frame_capture_frame() starts a glReadPixels() into the next of FRAME_CAPTURE_PBOS pixel buffer objects and
+ * puts a fence after it. The copy lands a frame or two later, the fence says when, and only then is the buffer
+ * mapped and copied into one of FRAME_CAPTURE_SLOTS frame slots for the worker. So the render thread only ever
+ * waits on the GPU when it gets a whole ring of reads ahead of it.
+ *
+ * Nothing is dropped. When the worker falls FRAME_CAPTURE_SLOTS frames behind, the render thread waits for it,
+ * so a capture that runs offscreen as fast as it can is paced by whatever the frames are written to.
+ *
+ * The target is either a printf pattern with one integer for the frame number, e.g. "capture/lamp_%05d.qoi",
+ * where the extension picks the format, or a shell command starting with '|' that gets the raw RGBA frames
+ * on stdin, e.g. "|ffmpeg -f rawvideo -pixel_format rgba -video_size 1280x720 -framerate 60 -i - lamp.mp4".
+ *
+ * Everything but the worker is render thread only.
+ *
+ */
+
+#define FRAME_CAPTURE_PBOS       3
+#define FRAME_CAPTURE_SLOTS      8
+#define FRAME_CAPTURE_TARGET_MAX 512
+
+typedef struct Frame_capture Frame_capture;
+struct Frame_capture {
+  b32 active;
+  s32 width;
+  s32 height;
+  char target[FRAME_CAPTURE_TARGET_MAX];
+  FILE *pipe;
+
+  /* reads in flight, oldest first */
+  u32    pbos[FRAME_CAPTURE_PBOS];
+  GLsync fences[FRAME_CAPTURE_PBOS];
+  u32    pbos_head;
+  u32    pbos_count;
+  u64    frames_read;
+
+  OS_handle thread;
+  OS_handle mutex;
+  OS_handle cond;
+  b32 quit;
+
+  /* the worker owns slots[queue_head] while it writes it, the render thread fills the one after the queue */
+  u8 *slots[FRAME_CAPTURE_SLOTS];
+  u64 slots_frame[FRAME_CAPTURE_SLOTS];
+  u32 queue_head;
+  u32 queue_count;
+
+  /* written by the worker */
+  u64 frames_written;
+  b32 failed;
+};
+
+
+b32  frame_capture_begin(Frame_capture *capture, char *target, s32 width, s32 height);
+void frame_capture_frame(Frame_capture *capture, u32 framebuffer);
+b32  frame_capture_end(Frame_capture *capture);
+
+
+#ifdef _UNITY_BUILD_
+#define FRAME_CAPTURE_IMPL
+#endif
+
+#ifdef FRAME_CAPTURE_IMPL
+
+#if OS_WINDOWS
+#define popen _popen
+#define pclose _pclose
+#else
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+
+
+/* glReadPixels() hands the rows over bottom up, and the alpha is whatever blending left in the back buffer */
+internal void frame_capture_fix_up(u8 *pixels, s32 width, s32 height) {
+  u64 row_size = (u64)width*4;
+
+  for(s32 y = 0; y < height/2; y++) {
+    u8 *a = pixels + row_size*y;
+    u8 *b = pixels + row_size*(height - 1 - y);
+
+    for(u64 i = 0; i < row_size; i++) {
+      u8 t = a[i];
+      a[i] = b[i];
+      b[i] = t;
+    }
+  }
+
+  for(u64 i = 3; i < row_size*height; i += 4) {
+    pixels[i] = 255;
+  }
+}
+
+internal b32 frame_capture_write(Frame_capture *capture, u8 *pixels, u64 frame) {
+  b32 result = 0;
+
+  frame_capture_fix_up(pixels, capture->width, capture->height);
+
+  if(capture->pipe) {
+    u64 size = (u64)capture->width*capture->height*4;
+    result = fwrite(pixels, 1, size, capture->pipe) == size;
+  } else {
+    char path[FRAME_CAPTURE_TARGET_MAX + 32];
+    snprintf(path, sizeof(path), capture->target, (int)frame);
+
+    Image image = {
+      .data    = pixels,
+      .width   = capture->width,
+      .height  = capture->height,
+      .mipmaps = 1,
+      .format  = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
+    };
+
+    result = ExportImage(image, path);
+  }
+
+  return result;
+}
+
+internal void frame_capture_worker(void *arg) {
+  Frame_capture *capture = arg;
+
+  for(;;) {
+    s64 slot = -1;
+
+    os_mutex_scope(capture->mutex) {
+      while(!capture->quit && capture->queue_count == 0) {
+        os_cond_wait(capture->cond, capture->mutex);
+      }
+
+      /* the queue is drained before quitting, frame_capture_end() wants every frame */
+      if(capture->queue_count) {
+        slot = capture->queue_head;
+      }
+    }
+
+    if(slot < 0) {
+      break;
+    }
+
+    /* after a failed write the frames are still taken off the queue, so the render thread never blocks on them */
+    if(!atomic_read(&capture->failed)) {
+      if(frame_capture_write(capture, capture->slots[slot], capture->slots_frame[slot])) {
+        atomic_add_eval(&capture->frames_written, 1);
+      } else {
+        TraceLog(LOG_ERROR, "frame capture couldn't write frame %llu to %s, dropping the rest",
+            (unsigned long long)capture->slots_frame[slot], capture->target);
+        atomic_write(&capture->failed, 1);
+      }
+    }
+
+    os_mutex_scope(capture->mutex) {
+      capture->queue_head = (capture->queue_head + 1) % FRAME_CAPTURE_SLOTS;
+      capture->queue_count--;
+      os_cond_broadcast(capture->cond);
+    }
+  }
+}
+
+/* maps the oldest read and hands it to the worker, waits for a free slot if the worker is behind,
+ * returns 0 while the read is still in flight */
+internal b32 frame_capture_collect(Frame_capture *capture, b32 wait) {
+  if(!capture->pbos_count) {
+    return 0;
+  }
+
+  u32 pbo = capture->pbos_head;
+
+  GLenum status = glClientWaitSync(capture->fences[pbo], GL_SYNC_FLUSH_COMMANDS_BIT, wait ? BILLION(1ull) : 0);
+
+  if(status == GL_TIMEOUT_EXPIRED) {
+    return 0;
+  }
+
+  glDeleteSync(capture->fences[pbo]);
+  capture->fences[pbo] = 0;
+
+  /* the read is gone for good, so is the capture, but the buffer is free again */
+  if(status == GL_WAIT_FAILED) {
+    if(!atomic_read(&capture->failed)) {
+      TraceLog(LOG_ERROR, "frame capture couldn't wait for frame %llu to be read back, dropping the rest",
+          (unsigned long long)(capture->frames_read - capture->pbos_count));
+      atomic_write(&capture->failed, 1);
+    }
+
+    capture->pbos_head = (pbo + 1) % FRAME_CAPTURE_PBOS;
+    capture->pbos_count--;
+
+    return 1;
+  }
+
+  u32 slot = 0;
+
+  os_mutex_scope(capture->mutex) {
+    while(capture->queue_count == FRAME_CAPTURE_SLOTS) {
+      os_cond_wait(capture->cond, capture->mutex);
+    }
+
+    slot = (capture->queue_head + capture->queue_count) % FRAME_CAPTURE_SLOTS;
+  }
+
+  u64 size = (u64)capture->width*capture->height*4;
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbos[pbo]);
+  void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_READ_BIT);
+
+  if(pixels) {
+    memory_copy(capture->slots[slot], pixels, size);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  } else {
+    memory_zero(capture->slots[slot], size);
+  }
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  capture->slots_frame[slot] = capture->frames_read - capture->pbos_count;
+  capture->pbos_head = (pbo + 1) % FRAME_CAPTURE_PBOS;
+  capture->pbos_count--;
+
+  os_mutex_scope(capture->mutex) {
+    capture->queue_count++;
+    os_cond_broadcast(capture->cond);
+  }
+
+  return 1;
+}
+
+b32 frame_capture_begin(Frame_capture *capture, char *target, s32 width, s32 height) {
+  memory_zero(capture, sizeof(*capture));
+
+  u64 target_len = strlen(target);
+
+  if(target_len >= FRAME_CAPTURE_TARGET_MAX || width <= 0 || height <= 0) {
+    TraceLog(LOG_ERROR, "can't capture %dx%d frames to %s", width, height, target);
+    return 0;
+  }
+
+  memory_copy(capture->target, target, target_len);
+  capture->width = width;
+  capture->height = height;
+
+  if(target[0] == '|') {
+#if !OS_WINDOWS
+    // NOTE when the command exits early, the write should fail instead of the whole process going down
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    capture->pipe = popen(target + 1, "w");
+
+    if(!capture->pipe) {
+      TraceLog(LOG_ERROR, "frame capture couldn't start %s", target + 1);
+      return 0;
+    }
+  } else {
+    char *slash = strrchr(capture->target, '/');
+
+    if(slash) {
+      *slash = 0;
+      MakeDirectory(capture->target);
+      *slash = '/';
+    }
+  }
+
+  u64 size = (u64)width*height*4;
+
+  glGenBuffers(FRAME_CAPTURE_PBOS, capture->pbos);
+
+  for(int i = 0; i < FRAME_CAPTURE_PBOS; i++) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbos[i]);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)size, 0, GL_STREAM_READ);
+  }
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  for(int i = 0; i < FRAME_CAPTURE_SLOTS; i++) {
+    capture->slots[i] = os_alloc(size);
+  }
+
+  capture->mutex = os_mutex_alloc();
+  capture->cond = os_cond_alloc();
+  capture->thread = os_thread_launch(frame_capture_worker, capture);
+
+  capture->active = 1;
+
+  TraceLog(LOG_INFO, "capturing %dx%d frames to %s", width, height, target);
+
+  return 1;
+}
+
+/* framebuffer has to be width x height, call it after the frame is drawn and outside of any texture mode */
+void frame_capture_frame(Frame_capture *capture, u32 framebuffer) {
+  if(!capture->active) {
+    return;
+  }
+
+  while(frame_capture_collect(capture, 0)) {}
+
+  /* a wait can time out on a slow GPU, the buffer isn't free until the read in it has landed */
+  while(capture->pbos_count == FRAME_CAPTURE_PBOS) {
+    frame_capture_collect(capture, 1);
+  }
+
+  u32 pbo = (capture->pbos_head + capture->pbos_count) % FRAME_CAPTURE_PBOS;
+
+  rlDrawRenderBatchActive();
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbos[pbo]);
+  glReadPixels(0, 0, capture->width, capture->height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+  capture->fences[pbo] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  capture->pbos_count++;
+  capture->frames_read++;
+}
+
+/* blocks until every frame read so far is written, returns 0 if any of them couldn't be */
+b32 frame_capture_end(Frame_capture *capture) {
+  if(!capture->active) {
+    return 1;
+  }
+
+  while(capture->pbos_count) {
+    frame_capture_collect(capture, 1);
+  }
+
+  os_mutex_scope(capture->mutex) {
+    capture->quit = 1;
+    os_cond_broadcast(capture->cond);
+  }
+
+  os_thread_join(capture->thread);
+
+  os_cond_release(capture->cond);
+  os_mutex_release(capture->mutex);
+
+  for(int i = 0; i < FRAME_CAPTURE_SLOTS; i++) {
+    os_free(capture->slots[i]);
+  }
+
+  glDeleteBuffers(FRAME_CAPTURE_PBOS, capture->pbos);
+
+  /* a command that failed, e.g. ffmpeg not finding its codec, fails the capture */
+  if(capture->pipe) {
+    int status = pclose(capture->pipe);
+
+#if !OS_WINDOWS
+    if(status != -1 && WIFEXITED(status)) {
+      status = WEXITSTATUS(status);
+    }
+#endif
+
+    if(status != 0) {
+      TraceLog(LOG_ERROR, "frame capture command %s exited with status %d", capture->target + 1, status);
+      capture->failed = 1;
+    }
+  }
+
+  TraceLog(capture->failed ? LOG_WARNING : LOG_INFO, "captured %llu frames to %s",
+      (unsigned long long)capture->frames_written, capture->target);
+
+  b32 result = !capture->failed;
+
+  memory_zero(capture, sizeof(*capture));
+
+  return result;
+}
+
+
+#endif
+
+#endif
@@ -0,0 +1,47 @@
+#version 330 core
+
+// NOTE
+// Dual filter blur (Bjorge, "Bandwidth-Efficient Rendering", SIGGRAPH 2015). The DOWN pass halves the size
+// with 5 bilinear taps, the UP pass doubles it with 8. Every tap lands between texels, so the hardware filter
+// averages 4 of them for free and a handful of levels gives a very wide blur for a few cheap passes.
+// The numbers have to match the order of GLOW_PASSES in lava_lamp.c.
+
+#define GLOW_PASS_DOWN 0
+#define GLOW_PASS_UP   1
+
+#ifndef GLOW_PASS
+#define GLOW_PASS GLOW_PASS_DOWN
+#endif
+
+in vec2 fragTexCoord;
+
+out vec4 finalColor;
+
+uniform sampler2D texture0;
+uniform vec2 half_pixel; // half a texel of the target being drawn, in uv
+uniform float intensity; // only the last up pass onto the screen is below 1
+
+void main() {
+  vec2 uv = fragTexCoord;
+
+#if GLOW_PASS == GLOW_PASS_DOWN
+  vec3 sum = texture(texture0, uv).rgb*4.0;
+  sum += texture(texture0, uv - half_pixel).rgb;
+  sum += texture(texture0, uv + half_pixel).rgb;
+  sum += texture(texture0, uv + vec2(half_pixel.x, -half_pixel.y)).rgb;
+  sum += texture(texture0, uv - vec2(half_pixel.x, -half_pixel.y)).rgb;
+  vec3 color = sum / 8.0;
+#else
+  vec3 sum = texture(texture0, uv + vec2(-half_pixel.x*2.0, 0.0)).rgb;
+  sum += texture(texture0, uv + vec2(-half_pixel.x, half_pixel.y)).rgb*2.0;
+  sum += texture(texture0, uv + vec2(0.0, half_pixel.y*2.0)).rgb;
+  sum += texture(texture0, uv + vec2(half_pixel.x, half_pixel.y)).rgb*2.0;
+  sum += texture(texture0, uv + vec2(half_pixel.x*2.0, 0.0)).rgb;
+  sum += texture(texture0, uv + vec2(half_pixel.x, -half_pixel.y)).rgb*2.0;
+  sum += texture(texture0, uv + vec2(0.0, -half_pixel.y*2.0)).rgb;
+  sum += texture(texture0, uv + vec2(-half_pixel.x, -half_pixel.y)).rgb*2.0;
+  vec3 color = sum / 12.0;
+#endif
+
+  finalColor = vec4(color*intensity, 1.0);
+}
@@ -0,0 +1,210 @@
+#ifndef HUD_H
+#define HUD_H
+
+
+#include "basic.h"
+#include "arena.h"
+#include "os.h"
+
+#include "third_party/microui/microui.h"
+#include "third_party/microui/murl.h"
+
+
+/* NOTE
+ *
+ * Performance overlay on top of microui. The game fills in the window between hud_begin() and hud_end(), the
+ * hud_graph() and hud_stat() helpers are for the usual frame time readouts.
+ *
+ * hud_draw() doesn't go through murl_render(), that one switches the scissor rect for every clip command and
+ * every switch flushes the batch. Clip commands are ignored here instead, microui already drops everything
+ * that's fully clipped, so at worst some text hangs over the edge of the window. Rects go through the shapes
+ * texture, which is the default font's texture, so the whole HUD ends up in a single draw call.
+ *
+ * The mu_Context is 256K of command buffer, it comes from whatever arena hud_init() gets.
+ *
+ */
+
+#define HUD_HISTORY 120
+
+typedef struct Hud Hud;
+struct Hud {
+  mu_Context *mu;
+  b32 visible;
+
+  u32 history_pos;
+
+  /* what the hud itself cost last frame, building and drawing */
+  f32 cost_ms;
+  u64 begin_ns;
+  u64 build_ns;
+};
+
+void hud_init(Hud *hud, Arena *arena);
+b32  hud_begin(Hud *hud);
+void hud_end(Hud *hud);
+void hud_draw(Hud *hud);
+void hud_graph(Hud *hud, char *label, f32 *history, f32 max_value, mu_Color color);
+void hud_stat(Hud *hud, char *label, char *fmt, ...);
+
+force_inline void hud_history_push(Hud *hud, f32 *history, f32 value);
+force_inline void hud_next_frame(Hud *hud);
+
+
+/* * * * * * * * * * *
+ * function bodies
+ */
+
+/* every history array is indexed with the same position, call hud_next_frame() once after pushing all of them */
+force_inline void hud_history_push(Hud *hud, f32 *history, f32 value) {
+  history[hud->history_pos % HUD_HISTORY] = value;
+}
+
+force_inline void hud_next_frame(Hud *hud) {
+  hud->history_pos++;
+}
+
+
+#ifdef _UNITY_BUILD_
+#define HUD_IMPL
+#endif
+
+#ifdef HUD_IMPL
+
+#include "third_party/microui/microui.c"
+#include "third_party/microui/murl.c"
+
+void hud_init(Hud *hud, Arena *arena) {
+  memory_zero(hud, sizeof(*hud));
+
+  hud->mu = push_struct(arena, mu_Context);
+  mu_init(hud->mu);
+  murl_setup_font(hud->mu);
+}
+
+/* returns whether the hud is up, the window only has to be built when it is */
+b32 hud_begin(Hud *hud) {
+  if(!hud->visible) {
+    return 0;
+  }
+
+  hud->begin_ns = os_now_ns();
+
+  murl_handle_input(hud->mu);
+  mu_begin(hud->mu);
+
+  return 1;
+}
+
+void hud_end(Hud *hud) {
+  mu_end(hud->mu);
+  hud->build_ns = os_now_ns() - hud->begin_ns;
+}
+
+void hud_draw(Hud *hud) {
+  if(!hud->visible) {
+    return;
+  }
+
+  u64 begin_ns = os_now_ns();
+
+  Font font = GetFontDefault();
+  f32 font_size = (f32)font.baseSize;
+  f32 spacing = (f32)hud->mu->style->spacing;
+
+  mu_Command *cmd = 0;
+  while(mu_next_command(hud->mu, &cmd)) {
+    switch(cmd->type) {
+      case MU_COMMAND_TEXT: {
+        DrawTextEx(font, cmd->text.str, MURL_VECTOR2_FROM_MU(cmd->text.pos), font_size, spacing, MURL_COLOR_FROM_MU(cmd->text.color));
+      } break;
+
+      case MU_COMMAND_RECT: {
+        DrawRectangleRec(MURL_RECTANGLE_FROM_MU(cmd->rect.rect), MURL_COLOR_FROM_MU(cmd->rect.color));
+      } break;
+
+      case MU_COMMAND_ICON: {
+        char *icon = "?";
+        switch(cmd->icon.id) {
+          case MU_ICON_CLOSE:     icon = "x"; break;
+          case MU_ICON_CHECK:     icon = "*"; break;
+          case MU_ICON_COLLAPSED: icon = "+"; break;
+          case MU_ICON_EXPANDED:  icon = "-"; break;
+        }
+
+        Vector2 size = MeasureTextEx(font, icon, font_size, spacing);
+        Vector2 pos = {
+          cmd->icon.rect.x + (cmd->icon.rect.w - size.x)*0.5f,
+          cmd->icon.rect.y + (cmd->icon.rect.h - size.y)*0.5f,
+        };
+
+        DrawTextEx(font, icon, pos, font_size, spacing, MURL_COLOR_FROM_MU(cmd->icon.color));
+      } break;
+
+      case MU_COMMAND_CLIP: {
+      } break;
+    }
+  }
+
+  hud->cost_ms = (f32)(hud->build_ns + os_now_ns() - begin_ns) * 1e-6f;
+}
+
+/* label with the last, average and worst value, then one bar per frame */
+void hud_graph(Hud *hud, char *label, f32 *history, f32 max_value, mu_Color color) {
+  mu_Context *mu = hud->mu;
+
+  f32 sum = 0;
+  f32 worst = 0;
+  for(int i = 0; i < HUD_HISTORY; i++) {
+    sum += history[i];
+    worst = MAX(worst, history[i]);
+  }
+
+  f32 last = history[(hud->history_pos + HUD_HISTORY - 1) % HUD_HISTORY];
+
+  hud_stat(hud, label, "%6.2f  avg %6.2f  max %6.2f", last, sum / HUD_HISTORY, worst);
+
+  mu_layout_row(mu, 1, (int[]){ -1 }, 32);
+  mu_Rect r = mu_layout_next(mu);
+
+  mu_draw_rect(mu, r, mu->style->colors[MU_COLOR_BASE]);
+
+  f32 bar_w = (f32)r.w / (f32)HUD_HISTORY;
+
+  for(int i = 0; i < HUD_HISTORY; i++) {
+    /* oldest on the left */
+    f32 value = history[(hud->history_pos + i) % HUD_HISTORY];
+    int h = (int)(CLAMP_TOP(value / max_value, 1.0f) * (f32)r.h);
+
+    if(h <= 0) {
+      continue;
+    }
+
+    mu_Rect bar = {
+      r.x + (int)(bar_w*(f32)i),
+      r.y + r.h - h,
+      MAX(1, (int)bar_w),
+      h,
+    };
+
+    mu_draw_rect(mu, bar, color);
+  }
+}
+
+void hud_stat(Hud *hud, char *label, char *fmt, ...) {
+  mu_Context *mu = hud->mu;
+
+  char buf[128];
+
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+
+  mu_layout_row(mu, 2, (int[]){ 90, -1 }, 0);
+  mu_label(mu, label);
+  mu_label(mu, buf);
+}
+
+#endif
+
+#endif
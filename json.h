@@ -19,6 +19,9 @@
 typedef struct JSON_parser JSON_parser;
 typedef struct JSON_value JSON_value;
 
+/* returns the first byte at or after pos that stops the scan, end if there's none */
+typedef u8* JSON_scan_func(u8 *pos, u8 *end);
+
 typedef enum JSON_value_kind {
   JSON_VALUE_KIND_INVALID = -1,
 #define X(kind) JSON_VALUE_KIND_##kind,
@@ -62,6 +65,10 @@ struct JSON_parser {
   int    err;
 
   JSON_value *root;
+
+  /* picked for cpu_level() by json_init_parser() */
+  JSON_scan_func *scan_whitespace;
+  JSON_scan_func *scan_string;
 };
 
 
@@ -89,6 +96,137 @@ Str8        json_parse_raw_string(JSON_parser *p);
 #define JLIB_JSON_IMPL
 #endif
 
+/* NOTE
+ * Skipping whitespace and finding the end of a string are where the parser spends its time on big files,
+ * so those two loops are kernels with a version for every cpu_level(). The wide ones test 16, 32 or 64
+ * bytes per compare and only fall back to the byte loop for the last few bytes of the source.
+ */
+force_inline b32 json_is_whitespace(u8 c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+internal u8* json_scan_whitespace_scalar_(u8 *pos, u8 *end) {
+  for(; pos < end && json_is_whitespace(*pos); pos++) {}
+  return pos;
+}
+
+/* stops on the closing quote or on a backslash, the caller skips the escaped byte */
+internal u8* json_scan_string_scalar_(u8 *pos, u8 *end) {
+  for(; pos < end && *pos != '"' && *pos != '\\'; pos++) {}
+  return pos;
+}
+
+#if CPU_X64
+
+internal u8* json_scan_whitespace_sse2_(u8 *pos, u8 *end) {
+  __m128i space = _mm_set1_epi8(' ');
+  __m128i newline = _mm_set1_epi8('\n');
+  __m128i carriage = _mm_set1_epi8('\r');
+  __m128i tab = _mm_set1_epi8('\t');
+
+  for(; pos + 16 <= end; pos += 16) {
+    __m128i v = _mm_loadu_si128((__m128i*)pos);
+    __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, newline)),
+                              _mm_or_si128(_mm_cmpeq_epi8(v, carriage), _mm_cmpeq_epi8(v, tab)));
+    u32 mask = ~(u32)_mm_movemask_epi8(ws) & 0xffff;
+
+    if(mask) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+
+  return json_scan_whitespace_scalar_(pos, end);
+}
+
+internal u8* json_scan_string_sse2_(u8 *pos, u8 *end) {
+  __m128i quote = _mm_set1_epi8('"');
+  __m128i backslash = _mm_set1_epi8('\\');
+
+  for(; pos + 16 <= end; pos += 16) {
+    __m128i v = _mm_loadu_si128((__m128i*)pos);
+    u32 mask = (u32)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+
+    if(mask) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+
+  return json_scan_string_scalar_(pos, end);
+}
+
+CPU_TARGET_AVX2 internal u8* json_scan_whitespace_avx2_(u8 *pos, u8 *end) {
+  __m256i space = _mm256_set1_epi8(' ');
+  __m256i newline = _mm256_set1_epi8('\n');
+  __m256i carriage = _mm256_set1_epi8('\r');
+  __m256i tab = _mm256_set1_epi8('\t');
+
+  for(; pos + 32 <= end; pos += 32) {
+    __m256i v = _mm256_loadu_si256((__m256i*)pos);
+    __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, newline)),
+                                 _mm256_or_si256(_mm256_cmpeq_epi8(v, carriage), _mm256_cmpeq_epi8(v, tab)));
+    u32 mask = ~(u32)_mm256_movemask_epi8(ws);
+
+    if(mask) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+
+  return json_scan_whitespace_sse2_(pos, end);
+}
+
+CPU_TARGET_AVX2 internal u8* json_scan_string_avx2_(u8 *pos, u8 *end) {
+  __m256i quote = _mm256_set1_epi8('"');
+  __m256i backslash = _mm256_set1_epi8('\\');
+
+  for(; pos + 32 <= end; pos += 32) {
+    __m256i v = _mm256_loadu_si256((__m256i*)pos);
+    u32 mask = (u32)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)));
+
+    if(mask) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+
+  return json_scan_string_sse2_(pos, end);
+}
+
+CPU_TARGET_AVX512 internal u8* json_scan_whitespace_avx512_(u8 *pos, u8 *end) {
+  __m512i space = _mm512_set1_epi8(' ');
+  __m512i newline = _mm512_set1_epi8('\n');
+  __m512i carriage = _mm512_set1_epi8('\r');
+  __m512i tab = _mm512_set1_epi8('\t');
+
+  for(; pos + 64 <= end; pos += 64) {
+    __m512i v = _mm512_loadu_si512((void*)pos);
+    u64 mask = ~(_mm512_cmpeq_epi8_mask(v, space) | _mm512_cmpeq_epi8_mask(v, newline) |
+                 _mm512_cmpeq_epi8_mask(v, carriage) | _mm512_cmpeq_epi8_mask(v, tab));
+
+    if(mask) {
+      return pos + __builtin_ctzll(mask);
+    }
+  }
+
+  return json_scan_whitespace_avx2_(pos, end);
+}
+
+CPU_TARGET_AVX512 internal u8* json_scan_string_avx512_(u8 *pos, u8 *end) {
+  __m512i quote = _mm512_set1_epi8('"');
+  __m512i backslash = _mm512_set1_epi8('\\');
+
+  for(; pos + 64 <= end; pos += 64) {
+    __m512i v = _mm512_loadu_si512((void*)pos);
+    u64 mask = _mm512_cmpeq_epi8_mask(v, quote) | _mm512_cmpeq_epi8_mask(v, backslash);
+
+    if(mask) {
+      return pos + __builtin_ctzll(mask);
+    }
+  }
+
+  return json_scan_string_avx2_(pos, end);
+}
+
+#endif
+
 void json_init_parser(JSON_parser *p, Arena *arena, u8 *src, s64 src_len) {
   p->arena = arena;
   p->src = src;
@@ -97,6 +235,28 @@ void json_init_parser(JSON_parser *p, Arena *arena, u8 *src, s64 src_len) {
   p->end = src + src_len;
   p->err = 0;
   p->root = 0;
+
+  p->scan_whitespace = json_scan_whitespace_scalar_;
+  p->scan_string = json_scan_string_scalar_;
+
+  switch(cpu_level()) {
+#if CPU_X64
+    case CPU_LEVEL_AVX512:
+      p->scan_whitespace = json_scan_whitespace_avx512_;
+      p->scan_string = json_scan_string_avx512_;
+      break;
+    case CPU_LEVEL_AVX2:
+      p->scan_whitespace = json_scan_whitespace_avx2_;
+      p->scan_string = json_scan_string_avx2_;
+      break;
+    case CPU_LEVEL_SSE2:
+      p->scan_whitespace = json_scan_whitespace_sse2_;
+      p->scan_string = json_scan_string_sse2_;
+      break;
+#endif
+    default:
+      break;
+  }
 }
 
 force_inline JSON_value* json_alloc_value(JSON_parser *p) {
@@ -116,17 +276,9 @@ JSON_value* json_parse(JSON_parser *p) {
 }
 
 force_inline void json_parse_skip_whitespace(JSON_parser *p) {
-  while(p->pos < p->end) {
-    switch(*p->pos) {
-      default:
-        return;
-      case ' ':
-      case '\n':
-      case '\r':
-      case '\t':
-        break;
-    }
-    p->pos++;
+  /* most calls land right on the next token, those don't need the kernel */
+  if(p->pos < p->end && json_is_whitespace(*p->pos)) {
+    p->pos = p->scan_whitespace(p->pos + 1, p->end);
   }
 }
 
@@ -313,9 +465,14 @@ Str8 json_parse_raw_string(JSON_parser *p) {
 
   u8 *end = begin;
 
-  while(end < p->end && *end != '"') {
-    if(*end == '\\') end++;
-    end++;
+  for(;;) {
+    end = p->scan_string(end, p->end);
+
+    if(end >= p->end || *end == '"') {
+      break;
+    }
+
+    end += 2;
   }
 
   if(end >= p->end) {
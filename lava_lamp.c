@@ -1,12 +1,22 @@
 #include "raylib.h"
 #include "raymath.h"
 #include "rlgl.h"
+#include "external/glad.h"
 
 #include "basic.h"
 #include "arena.h"
 #include "str.h"
 #include "context.h"
 #include "os.h"
+#include "rng.h"
+#include "sprite.h"
+#include "sprite_atlas.h"
+#include "sprite_batch.h"
+#include "asset_stream.h"
+#include "shader_manager.h"
+#include "profiler.h"
+#include "hud.h"
+#include "frame_capture.h"
 
 
 /* * * * * * * * * * *
@@ -15,9 +25,32 @@
 
 #define TARGET_FPS 60
 #define MIN_FPS 10
+#define UNFOCUSED_FPS 30
+#define IDLE_FPS 10
+#define HIDDEN_FPS 4
+#define IDLE_FRAMES_BEFORE_THROTTLE 30
 #define TARGET_DT ((float)1.0f/(float)TARGET_FPS)
 #define MIN_DT ((float)1.0f/(float)MIN_FPS)
+#define SIM_HZ 120
+#define SIM_DT ((float)1.0f/(float)SIM_HZ)
+#define SIM_STEP_NS (BILLION(1ull)/SIM_HZ)
+#define SIM_MAX_STEPS_PER_FRAME 8
+#define SIM_SEED 0x1a7a1a3dull
+#define SIM_RNG_STREAM 1
+#define SIM_STATE_FRESH 0x4
+#define SIM_STATE_INDEX_MASK 0x3
+#define SIM_REORDER_STEPS 60
+#define SIM_REORDER_CELL ((float)64.0) /* sim units */
+#define MORTON_CELL_BITS 10
+#define SIM_FORCE_LANES 16 /* partial sums per circle in the PAIRS kernel, a multiple of the widest vector */
 #define MAX_CIRCLES 2048
+#define CIRCLES_TEX_WIDTH 64 /* has to match blob_pixel.glsl */
+#define MAX_LAMPS 64         /* so does this */
+#define LAMPS_SIDE_MAX 8
+#define LAMP_PADDING ((float)0.06) /* of a grid cell, on every side, only with more than one lamp */
+#define PALETTE_MAX 256
+#define PALETTE_SLOTS 512
+#define MAX_SPRITES 256
 #define SCREEN_RECT ((Rectangle){ 0, 0, (float)GetScreenWidth(), (float)GetScreenHeight() })
 #define SCREEN_SIZE ((Vector2){ (float)GetScreenWidth(), (float)GetScreenHeight() })
 #define SCREEN_TOP_LEFT ((Vector2){ 0, 0, })
@@ -25,20 +58,144 @@
 #define SCREEN_BOTTOM_RIGHT ((Vector2){ (float)GetScreenWidth(), (float)GetScreenHeight(), })
 #define SCREEN_BOTTOM_LEFT ((Vector2){ 0, (float)GetScreenHeight(), })
 
+#define SPRITE_ATLAS_PATH "./aseprite/atlas.bin"
+#define BLOB_VERT_PATH "./blob_vert.glsl"
+#define BLOB_PIXEL_PATH "./blob_pixel.glsl"
+#define SPRITE_VERT_PATH "./sprite_vert.glsl"
+#define SPRITE_PIXEL_PATH "./sprite_pixel.glsl"
+#define GLOW_PIXEL_PATH "./glow_pixel.glsl"
+#define SHADER_CACHE_DIR "./.shader_cache"
+#define PROFILER_CAPTURE_PATH "./profile.json"
+#define FRAME_CAPTURE_PATH "./capture/lamp_%05d.qoi"
+
+#define BLOB_MIN_CIRCLES_BUCKET 16
+#define BLOB_CIRCLES_BUCKETS 8 /* BLOB_MIN_CIRCLES_BUCKET doubled up to MAX_CIRCLES */
+#define BLOB_JUMP_FLOOD_MIN_CIRCLES 256
+#define BLOB_GATHER_RADIUS_PER_K ((float)2.0)
+
 #define G ((float)50.0)
 #define MASS_TO_RADIUS ((float)300.23)
 #define FRICTION_TO_RADIUS ((float)2e-3)
+#define BLOB_K_DEFAULT ((float)65.6)
+
+#define FIELD_W 16
+#define FIELD_H 16
+#define FIELD_STRIDE (FIELD_W + 2) /* a ghost cell on every side */
+#define FIELD_CELLS  (FIELD_STRIDE*(FIELD_H + 2))
+#define FIELD_JACOBI_ITERATIONS 12
+#define FIELD_T_NEUTRAL      ((float)0.5)
+#define FIELD_HEAT_RATE      ((float)3.0)    /* per second, how fast the bottom row goes to 1 and the top row to 0 */
+#define FIELD_DIFFUSION      ((float)2000.0) /* sim units^2 per second */
+#define FIELD_FLUID_BUOYANCY ((float)400.0)  /* sim units per second^2 per unit of temperature */
+#define FIELD_COUPLING       ((float)4.0)    /* per second, how fast the fluid takes on the blobs' velocity and heat */
+#define FIELD_CONDUCTION     ((float)0.8)    /* per second, for a blob of FIELD_RADIUS_REF */
+#define FIELD_RADIUS_REF     ((float)100.0)
+#define FIELD_DRAG           ((float)1.5)    /* per second */
+#define BUOYANCY             ((float)900.0)  /* sim units per second^2 per unit of temperature */
+
+#define GPU_TIMER_QUERIES 3
+
+#define DYNAMIC_RES_BUDGET_MS ((float)8.0)
+#define DYNAMIC_RES_MIN_SCALE ((float)0.35)
+#define DYNAMIC_RES_STEP      ((float)0.05)
+#define DYNAMIC_RES_KP        ((float)0.2)
+#define DYNAMIC_RES_KI        ((float)0.04)
+
+#define GLOW_MAX_LEVELS         6
+#define GLOW_LEVELS_DEFAULT     5
+#define GLOW_INTENSITY_DEFAULT  ((float)0.4)
 
 
 /* * * * * * * * * * *
  * structs
  */
 
+// NOTE the order has to match the BLOB_BLEND_* and BLOB_COLOR_MIX_* numbers in blob_pixel.glsl
+#define BLOB_BLENDS               \
+  X(SMIN_CUBIC)                   \
+  X(SMIN_QUADRATIC)               \
+  X(METABALL)                     \
+
+typedef enum Blob_blend {
+  BLOB_BLEND_INVALID = -1,
+#define X(blend) BLOB_BLEND_##blend,
+  BLOB_BLENDS
+#undef X
+    BLOB_BLEND_MAX,
+} Blob_blend;
+
+#define BLOB_COLOR_MIXES          \
+  X(SMOOTH)                       \
+  X(NEAREST)                      \
+  X(WEIGHTED)                     \
+
+typedef enum Blob_color_mix {
+  BLOB_COLOR_MIX_INVALID = -1,
+#define X(mix) BLOB_COLOR_MIX_##mix,
+  BLOB_COLOR_MIXES
+#undef X
+    BLOB_COLOR_MIX_MAX,
+} Blob_color_mix;
+
+// NOTE the order has to match the BLOB_PASS_* numbers in blob_pixel.glsl
+#define BLOB_PASSES               \
+  X(LOOP)                         \
+  X(JUMP_FLOOD_STEP)              \
+  X(JUMP_FLOOD_SHADE)             \
+
+typedef enum Blob_pass {
+  BLOB_PASS_INVALID = -1,
+#define X(pass) BLOB_PASS_##pass,
+  BLOB_PASSES
+#undef X
+    BLOB_PASS_MAX,
+} Blob_pass;
+
+/* AUTO loops over every circle for small counts and switches to the jump flood at BLOB_JUMP_FLOOD_MIN_CIRCLES */
+#define BLOB_PIPELINES            \
+  X(AUTO)                         \
+  X(LOOP)                         \
+  X(JUMP_FLOOD)                   \
+
+typedef enum Blob_pipeline {
+  BLOB_PIPELINE_INVALID = -1,
+#define X(pipeline) BLOB_PIPELINE_##pipeline,
+  BLOB_PIPELINES
+#undef X
+    BLOB_PIPELINE_MAX,
+} Blob_pipeline;
+
+#define SIM_FORCES                \
+  X(PAIRS)                        \
+  X(FIELD)                        \
+
+typedef enum Sim_forces {
+  SIM_FORCES_INVALID = -1,
+#define X(forces) SIM_FORCES_##forces,
+  SIM_FORCES
+#undef X
+    SIM_FORCES_MAX,
+} Sim_forces;
+
+// NOTE the order has to match the GLOW_PASS_* numbers in glow_pixel.glsl
+#define GLOW_PASSES               \
+  X(DOWN)                         \
+  X(UP)                           \
+
+typedef enum Glow_pass {
+  GLOW_PASS_INVALID = -1,
+#define X(pass) GLOW_PASS_##pass,
+  GLOW_PASSES
+#undef X
+    GLOW_PASS_MAX,
+} Glow_pass;
+
 typedef struct Circle {
   Vector2 accel;
   Vector2 vel;
   f32     friction;
   f32     mass;
+  f32     temperature; /* see Sim_field */
 
   Vector2 center;
   f32     radius;
@@ -47,33 +204,312 @@ typedef struct Circle {
 
 } Circle;
 
+/* one RG32UI texel, see get_circle() in blob_pixel.glsl */
 typedef struct GPU_circle {
-  u16 center_x;
+  u16 center_x; /* unorm, fraction of the target, y is flipped */
   u16 center_y;
-  u16 radius;
-  u16 softness;
-  u16 color_x;
-  u16 color_y;
-  u16 color_z;
-  u16 color_w;
+  u16 radius;   /* pixels, 12.4 fixed point */
+  u8  reserved; /* zero, every edge is BLOB_SOFTNESS wide, see blob_pixel.glsl */
+  u8  color;    /* palette index */
 } GPU_circle;
 
+STATIC_ASSERT(sizeof(GPU_circle) == 8, gpu_circle_is_one_rg32ui_texel);
+
+/* NOTE
+ * The circles as the blob shader sees them. circles_tex is CIRCLES_TEX_WIDTH texels wide and as many rows as
+ * MAX_CIRCLES needs, so it stays under the 1024 texel size GL 3.3 guarantees, and only the rows in use get
+ * uploaded. Colors go through a palette of PALETTE_MAX RGBA8 entries, a color gets an entry the first time
+ * it's packed. Once the palette is full, new colors take the closest entry.
+ */
+typedef struct GPU_circles {
+  GPU_circle circles[MAX_CIRCLES];
+  int circles_count;
+  Texture2D circles_tex;
+
+  s32 lamps_side;
+  Vector4 lamp_rects[MAX_LAMPS]; /* unorm of the target */
+  s32 lamp_ranges[2*MAX_LAMPS];  /* first, count */
+
+  Color palette[PALETTE_MAX];
+  int palette_count;
+  u16 palette_slots[PALETTE_SLOTS]; /* open addressing on the color, palette index + 1, 0 is empty */
+  b32 palette_dirty;
+  Texture2D palette_tex;
+} GPU_circles;
+
+typedef struct GPU_circles_locs {
+  int circles_tex;
+  int circles_count;
+  int palette_tex;
+  int target_size;
+  int render_scale;
+  int lamps_side;
+  int lamp_rects;
+  int lamp_ranges;
+} GPU_circles_locs;
+
+// NOTE the G, BUOYANCY, MASS_TO_RADIUS and FRICTION_TO_RADIUS macros are only the defaults, the HUD can change these
+typedef struct Sim_params {
+  Sim_forces forces;
+  f32 g;        /* PAIRS */
+  f32 buoyancy; /* FIELD */
+  f32 mass_to_radius;
+  f32 friction_to_radius;
+} Sim_params;
+
+#define SIM_PARAMS_DEFAULT ((Sim_params){ .forces = SIM_FORCES_FIELD, .g = G, .buoyancy = BUOYANCY, .mass_to_radius = MASS_TO_RADIUS, .friction_to_radius = FRICTION_TO_RADIUS })
+
+/* NOTE
+ * What moves the blobs with SIM_FORCES_FIELD. Every lamp has a coarse grid of the liquid around the blobs,
+ * FIELD_W x FIELD_H cells over the lamp's bounds, each with a temperature and a velocity. The bottom row is
+ * the heater and the top row is cooled, hot liquid rises and cold liquid sinks, and the liquid is kept
+ * incompressible, which turns that into convection rolls.
+ *
+ * The blobs are coupled to it particle in cell style. Every step each blob deposits its velocity and heat into
+ * the 4 cells around its center, weighted by its area, then the grid is stepped, and then every blob samples
+ * the grid back, takes on the liquid's temperature the slower the bigger it is and is dragged along with the
+ * liquid. A blob hotter than FIELD_T_NEUTRAL rises, a colder one sinks. Nothing looks at pairs of blobs, the
+ * cost is O(circles + cells) where the PAIRS forces are O(circles^2).
+ *
+ * The grid has a ghost cell on every side, so the stencils run over whole rows without any edge cases.
+ */
+typedef struct Sim_field {
+  f32 temperature[FIELD_CELLS]; /* 0 cold, 1 as hot as the heater */
+  f32 vel_x[FIELD_CELLS];
+  f32 vel_y[FIELD_CELLS];
+} Sim_field;
+
+/* NOTE
+ * Lamps. The screen is a lamps_side x lamps_side grid with one lamp in every cell, and every lamp owns a
+ * contiguous range of the circle array. A lamp is simulated in bounds that are as tall as the screen and as
+ * wide as the lamp's aspect asks for, so a small lamp moves exactly like the full screen one and only gets
+ * scaled down when it's packed. All of them are stepped back to back in the same sim step, and drawn in one
+ * pass, the blob shader finds the lamp of a pixel from the grid and only blends the circles in its range.
+ */
+typedef struct Sim_lamp {
+  s32 first;
+  s32 count;
+  f32 g_scale; /* every lamp but the first pulls a little differently, so they don't all move the same */
+} Sim_lamp;
+
+typedef struct Sim_state {
+  Circle  circles[MAX_CIRCLES];
+  Vector2 prev_centers[MAX_CIRCLES]; /* centers before the last step, for interpolation */
+  u16     handles[MAX_CIRCLES];
+  int     circles_count;
+  Sim_lamp lamps[MAX_LAMPS];
+  int     lamps_count;
+  s32     lamps_side;
+  u64     step;
+  u64     time_ns; /* when the last step was due */
+} Sim_state;
+
+/* NOTE
+ * Circles spawn in whatever order and then wander all over their lamp, so circles that are close on screen end
+ * up far apart in memory. Every SIM_REORDER_STEPS steps each lamp's circles are sorted by the Morton code of
+ * the SIM_REORDER_CELL sized cell they're in, which puts neighbours next to each other again for anything that
+ * walks the circles by position. Nobody outside of the sim sees the new order, every circle keeps the handle
+ * it spawned with in handles[], and the pack writes it to that index on the GPU. So the blend order, and with
+ * it the picture, stays the same.
+ */
+
+/* NOTE
+ * The sim runs on its own thread at SIM_HZ and publishes finished states through a triple buffer. The sim
+ * thread owns states[back], the render thread owns states[front], and the one left over sits in the middle.
+ * Both sides only ever swap their index with the middle one, the sim sets SIM_STATE_FRESH when it does,
+ * so the renderer knows there's something new. Nobody waits on anybody.
+ */
+typedef struct Sim {
+  /* sim thread only */
+  Circle circles[MAX_CIRCLES];
+  u16    handles[MAX_CIRCLES]; /* where every circle was spawned, see the note on reordering */
+  int    circles_count;
+  Sim_lamp lamps[MAX_LAMPS];
+  Sim_field fields[MAX_LAMPS];
+  int    lamps_count;
+  s32    lamps_side;
+  u64    step;
+  u32    back;
+  Sim_params params;
+  u32    params_version_seen;
+  Rng    rng;
+
+  /* render thread only */
+  u32    front;
+
+  Sim_state states[3];
+  u32    middle;
+
+  /* written by the render thread */
+  u64    bounds; /* screen width << 32 | screen height */
+  u32    paused;
+  u32    reset_requested;
+  u32    lamps_side_requested; /* the sim resets when this changes */
+  u32    quit;
+
+  /* params change a few times a second at most, a mutex is fine for those */
+  OS_handle params_mutex;
+  Sim_params params_in;
+  u32    params_version;
+
+  /* written by the sim thread, for the HUD */
+  u64    step_ns;
+
+  OS_handle thread;
+} Sim;
+
+/* NOTE
+ * Nearest circle field for the jump flood pipeline. Both targets are RGBA8 at the size of the screen and
+ * hold circle index + 1 in rg, so 0 is no circle. Every circle gets one seed pixel, then each step pass
+ * reads the other target, so after log2(size) passes the last one written has the nearest circle of every
+ * pixel. The cost only depends on the resolution, the circle count only matters for the seed splat.
+ */
+typedef struct Jump_flood {
+  RenderTexture2D targets[2];
+
+  Shader shader;
+  int nearest_tex_loc;
+  int jump_loc;
+  GPU_circles_locs circles_locs;
+} Jump_flood;
+
+/* NOTE
+ * Dynamic resolution. The blob pass draws into target at scale times the screen size, and the composite
+ * stretches that over the screen. The pass is fill bound, so the controller works on scale^2, the pixel
+ * count, and runs once per GPU timer sample. It's a PI controller: the integral term settles on the scale
+ * that fits the budget, the proportional term pushes back on spikes. The target is only resized when the
+ * wanted scale is a whole DYNAMIC_RES_STEP away from the one in use, so noise doesn't reallocate it.
+ */
+typedef struct Dynamic_res {
+  b32 enabled;
+  f32 budget_ms;
+  f32 integral;
+  f32 scale;   /* what the controller wants */
+  f32 applied; /* what the target is sized for */
+  u32 samples_seen;
+  RenderTexture2D target;
+} Dynamic_res;
+
+/* NOTE
+ * Ring of GL_TIME_ELAPSED queries around one stretch of draws, read back a few frames late so we never stall.
+ * Queries of the same kind can't nest, so timers have to time separate stretches. samples goes up by one
+ * every time ms is updated.
+ */
+typedef struct Gpu_timer {
+  u32 queries[GPU_TIMER_QUERIES];
+  b32 queries_issued[GPU_TIMER_QUERIES];
+  u32 query_index;
+  f32 ms;
+  u32 samples;
+} Gpu_timer;
+
+/* NOTE
+ * Glow on top of the blobs. The finished blobs are blitted off the back buffer into mips[0] at half the size,
+ * the DOWN pass halves that levels - 1 more times, the UP pass walks back up overwriting each level, and the
+ * last UP pass lands on the screen with additive blending scaled by intensity. Everything but the last pass
+ * works on a quarter of the pixels or less, so the cost is about one full screen pass of 8 taps.
+ */
+typedef struct Glow {
+  b32 enabled;
+  s32 levels;
+  f32 intensity;
+
+  RenderTexture2D mips[GLOW_MAX_LEVELS];
+
+  Shader shaders[GLOW_PASS_MAX];
+  int half_pixel_locs[GLOW_PASS_MAX];
+  int intensity_locs[GLOW_PASS_MAX];
+} Glow;
+
+/* NOTE
+ * Everything the scene under the HUD is drawn from. When a frame's key matches the last one, the frame
+ * would come out the same, so the back buffer gets copied into frame_cache once and every frame after that
+ * just copies it back until something changes. The HUD is drawn on top either way. Sprites animate on
+ * their own clock, even while the sim is paused, so the key has the batch's revision rather than a count.
+ */
+typedef struct Frame_key {
+  u64 sim_step;
+  f32 sim_alpha;
+  s32 width;
+  s32 height;
+  u32 blob_shader_id;
+  u32 blob_shader_generation;
+  f32 blob_k;
+  f32 render_scale;
+  u32 sprites_revision;
+  s32 glow_levels;
+  f32 glow_intensity;
+} Frame_key;
+
 typedef struct Game {
   f32 dt;
   f32 shader_dt;
   b32 quit;
 
+  Asset_stream assets;
+
+  Shader_manager shaders;
+
+  s32 blob_shader_program;
+  s32 blob_shader_variant;
+  u32 blob_shader_generation;
   Shader blob_shader;
-  Circle circles_buf[MAX_CIRCLES];
-  GPU_circle gpu_circles_buf[MAX_CIRCLES];
-  Texture2D circles_tex;
+  Blob_pass blob_shader_pass; /* lags behind blob_pipeline until the new variant is built */
+  Blob_blend blob_blend;
+  Blob_color_mix blob_color_mix;
+  Blob_pipeline blob_pipeline;
+  s32 jump_flood_shader_variant;
+  u32 jump_flood_shader_generation;
+  Jump_flood jump_flood;
+  Vector2 jump_flood_seeds[MAX_CIRCLES];
+  Sim sim;
+  f32 sim_alpha;
+  Sim_params sim_params;
+  f32 blob_k;
+  GPU_circles gpu_circles;
   Texture2D white_tex;
 
+  Asset_handle sprite_atlas;
+  Sprite_batch sprite_batch;
+  s32 sprite_shader_program;
+  Shader sprite_shader;
+
 
   int shader_dt_loc;
   int circles_count;
-  int circles_tex_loc;
-  int circles_count_loc;
+  int lamp_circles_max; /* the most circles in any one lamp, that's what the loop pass pays for */
+  s32 lamps_side;
+  f32 lamp_scale;       /* lamp sim units to screen pixels */
+  GPU_circles_locs circles_locs;
+  int k_loc;
+  int nearest_tex_loc;
+  int gather_radius_loc;
+
+  Hud hud;
+  f32 hud_frame_ms[HUD_HISTORY];
+  f32 hud_render_ms[HUD_HISTORY];
+  f32 hud_sim_ms[HUD_HISTORY];
+  f32 hud_gpu_ms[HUD_HISTORY];
+  f32 hud_glow_ms[HUD_HISTORY];
+
+  Gpu_timer blob_timer;
+  Gpu_timer glow_timer;
+
+  Dynamic_res dynamic_res;
+
+  s32 glow_shader_program;
+  s32 glow_shader_variants[GLOW_PASS_MAX];
+  Glow glow;
+
+  Frame_key frame_key;
+  u32 idle_frames;
+  RenderTexture2D frame_cache;
+  b32 frame_cache_valid;
+  s32 target_fps;
+
+  Frame_capture capture;
+
+  f32 render_ms; /* cpu time of the last frame, minus the swap */
 
   b32 created_balls;
 
@@ -86,14 +522,34 @@ typedef struct Game {
 
 STATIC_ASSERT(MB(1) >= sizeof(Game), game_state_struct_is_less_than_1_megabyte);
 
+STATIC_ASSERT(BLOB_MIN_CIRCLES_BUCKET << (BLOB_CIRCLES_BUCKETS - 1) == MAX_CIRCLES, blob_circles_buckets_reach_max_circles);
+
+/* the blob, sprite and glow programs, every loop look per circle bucket, every shade look, the step pass and the glow passes */
+STATIC_ASSERT(3 + BLOB_BLEND_MAX*BLOB_COLOR_MIX_MAX*(BLOB_CIRCLES_BUCKETS + 1) + 1 + GLOW_PASS_MAX <= SHADER_MANAGER_MAX_PROGRAMS,
+    every_shader_variant_fits_in_the_shader_manager);
+
 u64 game_state_size = MAX(MB(1), sizeof(Game));
 
 /* * * * * * * * * * *
  * globals
  */
 
-Matrix mat_rotate_pi_over_4;
-b32 cached_mat_rotate_pi_over_4;
+mu_Color hud_frame_color  = { 0x5a, 0xc8, 0xfa, 0xff };
+mu_Color hud_render_color = { 0xf7, 0x00, 0xce, 0xff };
+mu_Color hud_sim_color    = { 0xa4, 0x00, 0xf7, 0xff };
+mu_Color hud_gpu_color    = { 0xf7, 0x00, 0x52, 0xff };
+
+char *blob_pipeline_names[] = {
+#define X(pipeline) #pipeline,
+  BLOB_PIPELINES
+#undef X
+};
+
+char *sim_forces_names[] = {
+#define X(forces) #forces,
+  SIM_FORCES
+#undef X
+};
 
 
 /* * * * * * * * * * *
@@ -105,20 +561,70 @@ void game_close(Game *gp);
 void game_update_and_draw(Game* gp);
 void game_load_assets(Game* gp);
 void game_unload_assets(Game* gp);
-
-float get_random_float(float min, float max, int steps);
+void game_update_assets(Game *gp);
+void game_reload_file(Game *gp, char *path);
+s32  game_blob_shader_variant(Game *gp, Blob_pass pass);
+Blob_pass game_blob_pass(Game *gp);
+Str8 blob_shader_defines(Blob_blend blend, Blob_color_mix color_mix, int circles_count, Blob_pass pass);
+void jump_flood_set_shader(Jump_flood *jf, Shader shader);
+Texture2D jump_flood_run(Jump_flood *jf, GPU_circles *gc, Vector2 *seeds, int width, int height, f32 render_scale);
+void jump_flood_close(Jump_flood *jf);
+void dynamic_res_init(Dynamic_res *dr);
+void dynamic_res_update(Dynamic_res *dr, f32 gpu_ms);
+RenderTexture2D dynamic_res_target(Dynamic_res *dr, int screen_width, int screen_height);
+void dynamic_res_close(Dynamic_res *dr);
+void glow_init(Glow *glow);
+void glow_set_shader(Glow *glow, Glow_pass pass, Shader shader);
+void glow_run(Glow *glow, u32 source_framebuffer, int width, int height);
+void glow_composite(Glow *glow, Rectangle dst, int width, int height);
+void glow_draw_pass(Glow *glow, Glow_pass pass, Texture2D src, Rectangle dst, int width, int height, f32 intensity);
+void glow_close(Glow *glow);
+void game_draw_blobs(Game *gp, Texture2D nearest_tex, int width, int height, Vector2 target_size, f32 render_scale);
+void game_draw_scene(Game *gp, Vector2 dpi_scale_factor);
+void game_pace_frames(Game *gp);
+void frame_cache_capture(RenderTexture2D *cache, int width, int height);
+void frame_cache_present(RenderTexture2D cache);
+GPU_circle gpu_circle_pack(Circle c, u8 color, Vector2 screen_size, f32 scalar_dpi_scale_factor);
+void gpu_circles_init(GPU_circles *gc);
+void gpu_circles_close(GPU_circles *gc);
+u8   gpu_circles_color(GPU_circles *gc, Color color);
+void gpu_circles_clear_palette(GPU_circles *gc);
+void gpu_circles_upload(GPU_circles *gc);
+GPU_circles_locs gpu_circles_locs(Shader shader);
+void gpu_circles_set_uniforms(GPU_circles *gc, Shader shader, GPU_circles_locs locs, Vector2 target_size, f32 render_scale);
+void gpu_circles_set_lamp(GPU_circles *gc, int lamp, Rectangle rect, int first, int count);
+int  gpu_circles_pack_state(GPU_circles *gc, Sim_state *state, f32 alpha, Vector2 screen_size, Vector2 dpi_scale_factor, f32 scalar_dpi_scale_factor, Vector2 *seeds);
+Rectangle lamp_rect(s32 lamps_side, int lamp, Vector2 screen_size);
+Vector2 lamp_sim_bounds(s32 lamps_side, Vector2 screen_size);
+f32 lamp_scale(s32 lamps_side, Vector2 screen_size);
+void sim_step(Circle *circles, int circles_count, Sim_field *field, Sim_params params, f32 dt, Vector2 bounds, f32 g_scale);
+void field_reset(Sim_field *field);
+void field_step(Sim_field *field, Circle *circles, int circles_count, f32 dt, Vector2 bounds, f32 buoyancy);
+void sim_step_lamps(Sim *sim, Vector2 screen_size);
+void sim_reorder(Sim *sim);
+void circles_sort_morton(Circle *circles, u16 *handles, int circles_count, f32 cell_size);
+void sim_set_params(Sim *sim, Sim_params params);
+void sim_apply_params(Sim *sim);
+void game_hud(Game *gp);
+void gpu_timer_init(Gpu_timer *timer);
+void gpu_timer_close(Gpu_timer *timer);
+void gpu_timer_begin(Gpu_timer *timer);
+void gpu_timer_end(Gpu_timer *timer);
+void sim_start(Sim *sim);
+void sim_stop(Sim *sim);
+void sim_thread(void *arg);
+void sim_reset(Sim *sim, Vector2 bounds);
+void sim_publish(Sim *sim, u64 time_ns);
+Sim_state* sim_acquire(Sim *sim);
+force_inline void sim_set_bounds(Sim *sim, Vector2 bounds);
+
+Color color_from_hexcode(Str8 hexcode);
 
 
 /* * * * * * * * * * *
  * function bodies
  */
 
-force_inline float get_random_float(float min, float max, int steps) {
-  int val = GetRandomValue(0, steps);
-  float result = Remap((float)val, 0.0f, (float)steps, min, max);
-  return result;
-}
-
 Game *game_init(void) {
 
   // raylib initialization
@@ -133,34 +639,44 @@ Game *game_init(void) {
   SetTraceLogLevel(LOG_DEBUG);
   SetExitKey(0);
 
+  TraceLog(LOG_INFO, "cpu level %s", cpu_level_names[cpu_level()]);
+
   Game *gp = os_alloc(game_state_size);
   memory_set(gp, 0, game_state_size);
 
-  game_load_assets(gp);
+  gp->main_arena = arena_alloc(.size = KB(64));
+  gp->frame_arena = arena_alloc(.size = KB(4));
 
-  Image circles_tex_img =
-  {
-    .data = gp->gpu_circles_buf,
-    .width = ARRLEN(gp->gpu_circles_buf),
-    .height = 1,
-    .mipmaps = 1,
-    .format = PIXELFORMAT_UNCOMPRESSED_R16G16B16A16,
-  };
+  gp->sim.back = 0;
+  gp->sim.middle = 1;
+  gp->sim.front = 2;
+  gp->sim.params = SIM_PARAMS_DEFAULT;
+  gp->sim.params_in = SIM_PARAMS_DEFAULT;
+  gp->sim.rng = rng_seed(SIM_SEED, SIM_RNG_STREAM);
+  gp->sim.lamps_side_requested = 1;
+  sim_set_bounds(&gp->sim, SCREEN_SIZE);
 
-  gp->circles_tex = LoadTextureFromImage(circles_tex_img);
+  gp->sim_params = SIM_PARAMS_DEFAULT;
+  gp->blob_k = BLOB_K_DEFAULT;
+  gp->target_fps = TARGET_FPS;
+  gp->lamps_side = 1;
 
-  Image white_tex_img = GenImageColor(1, 1, WHITE);
-  gp->white_tex = LoadTextureFromImage(white_tex_img);
-  UnloadImage(white_tex_img);
+  hud_init(&gp->hud, gp->main_arena);
 
-  gp->main_arena = arena_alloc(.size = KB(20));
-  gp->frame_arena = arena_alloc(.size = KB(4));
+  gpu_timer_init(&gp->blob_timer);
+  gpu_timer_init(&gp->glow_timer);
+
+  sprite_batch_init(&gp->sprite_batch, gp->main_arena, MAX_SPRITES);
+
+  game_load_assets(gp);
 
-  //int screen_rect_loc = GetShaderLocation(blob_shader, "screen_rect");
+  gpu_circles_init(&gp->gpu_circles);
+  dynamic_res_init(&gp->dynamic_res);
+  glow_init(&gp->glow);
 
-  gp->circles_tex_loc = GetShaderLocation(gp->blob_shader, "circles_tex");
-  gp->circles_count_loc = GetShaderLocation(gp->blob_shader, "circles_count");
-  gp->shader_dt_loc = GetShaderLocation(gp->blob_shader, "dt");
+  Image white_tex_img = GenImageColor(1, 1, WHITE);
+  gp->white_tex = LoadTextureFromImage(white_tex_img);
+  UnloadImage(white_tex_img);
 
   //Image white_img = GenImageColor(1, 1, WHITE);
   //Texture2D white_tex = LoadTextureFromImage(white_img);
@@ -169,262 +685,1867 @@ Game *game_init(void) {
 }
 
 void game_close(Game *gp) {
+  frame_capture_end(&gp->capture);
   game_unload_assets(gp);
+  sprite_batch_close(&gp->sprite_batch);
+  jump_flood_close(&gp->jump_flood);
+  gpu_circles_close(&gp->gpu_circles);
+  dynamic_res_close(&gp->dynamic_res);
+  glow_close(&gp->glow);
+
+  if(gp->frame_cache.id) {
+    UnloadRenderTexture(gp->frame_cache);
+  }
+
+  gpu_timer_close(&gp->blob_timer);
+  gpu_timer_close(&gp->glow_timer);
 
   CloseWindow();
   CloseAudioDevice();
 
 }
 
+// NOTE nothing here blocks, everything streams in over the next few frames, see game_update_assets()
 void game_load_assets(Game* gp) {
-  gp->blob_shader = LoadShader("blob_vert.glsl", "blob_pixel.glsl");
+  prof_init();
+  prof_thread_name("main");
+
+  asset_stream_init(&gp->assets);
+
+  shader_manager_init(&gp->shaders, &gp->assets, SHADER_CACHE_DIR);
+
+  gp->blob_shader_program = shader_manager_add(&gp->shaders, str8_lit(BLOB_VERT_PATH), str8_lit(BLOB_PIXEL_PATH));
+  gp->sprite_shader_program = shader_manager_add(&gp->shaders, str8_lit(SPRITE_VERT_PATH), str8_lit(SPRITE_PIXEL_PATH));
+  gp->glow_shader_program = shader_manager_add(&gp->shaders, str8_lit(BLOB_VERT_PATH), str8_lit(GLOW_PIXEL_PATH));
+
+  for(Glow_pass pass = 0; pass < GLOW_PASS_MAX; pass++) {
+    scratch_scope() {
+      gp->glow_shader_variants[pass] = shader_manager_variant(&gp->shaders, gp->glow_shader_program, scratch_push_str8f("#define GLOW_PASS %i\n", pass));
+    }
+  }
+  gp->blob_shader_variant = -1;
+  gp->blob_shader_generation = 0;
+  gp->jump_flood_shader_variant = -1;
+  gp->jump_flood_shader_generation = 0;
+
+  // NOTE the sim thread runs module code, so it lives and dies with the module like the asset stream does
+  sim_start(&gp->sim);
+
+  // NOTE the binary atlas is optional, it only exists once the metaprogram has been run
+  if(FileExists(SPRITE_ATLAS_PATH)) {
+    gp->sprite_atlas = asset_stream_request(&gp->assets, ASSET_KIND_SPRITE_ATLAS, str8_lit(SPRITE_ATLAS_PATH));
+  }
 
 }
 
 void game_unload_assets(Game* gp) {
 
-  UnloadShader(gp->blob_shader);
+  sim_stop(&gp->sim);
+
+  shader_manager_close(&gp->shaders);
+  gp->blob_shader = (Shader){0};
+  gp->sprite_shader = (Shader){0};
+  jump_flood_set_shader(&gp->jump_flood, (Shader){0});
+
+  for(Glow_pass pass = 0; pass < GLOW_PASS_MAX; pass++) {
+    glow_set_shader(&gp->glow, pass, (Shader){0});
+  }
+
   //UnloadTexture(circles_tex);
 
+  sprite_batch_set_atlas(&gp->sprite_batch, (Texture2D){0}, 0, 0);
+
+  asset_stream_close(&gp->assets);
+
+  // NOTE last, the sim thread records zones until it's stopped
+  prof_close();
+
 }
 
-Color color_from_hexcode(Str8 hexcode) {
+void game_update_assets(Game *gp) {
+  asset_stream_update(&gp->assets, ASSET_STREAM_DEFAULT_UPLOAD_BUDGET);
 
-  u8 components[4] = { 0, 0, 0, 0xff, };
+  Blob_pass blob_pass = game_blob_pass(gp);
+  s32 blob_shader_variant = game_blob_shader_variant(gp, blob_pass);
+  s32 jump_flood_shader_variant = game_blob_shader_variant(gp, BLOB_PASS_JUMP_FLOOD_STEP);
 
-  int i = 0; 
-  if(hexcode.s[0] == '#') {
-    i++;
+  shader_manager_update(&gp->shaders);
+
+  gp->sprite_shader = shader_manager_get(&gp->shaders, gp->sprite_shader_program);
+
+  for(Glow_pass pass = 0; pass < GLOW_PASS_MAX; pass++) {
+    glow_set_shader(&gp->glow, pass, shader_manager_get(&gp->shaders, gp->glow_shader_variants[pass]));
   }
-  for(int c = 0; i < hexcode.len; i += 2, c++) {
-    u8 a = hexcode.s[i];
-    u8 b = hexcode.s[i+1];
 
-    components[c] = (hexdigit_to_int(a) << 4) + hexdigit_to_int(b);
+  u32 jump_flood_shader_generation = shader_manager_generation(&gp->shaders, jump_flood_shader_variant);
+
+  if(jump_flood_shader_generation && (gp->jump_flood_shader_variant != jump_flood_shader_variant || gp->jump_flood_shader_generation != jump_flood_shader_generation)) {
+    gp->jump_flood_shader_variant = jump_flood_shader_variant;
+    gp->jump_flood_shader_generation = jump_flood_shader_generation;
+    jump_flood_set_shader(&gp->jump_flood, shader_manager_get(&gp->shaders, jump_flood_shader_variant));
   }
 
-  Color result = { .r = components[0], .g = components[1], .b = components[2], .a = components[3] };
+  // NOTE keep drawing with the current variant until the new one is built, the shade pass also needs the step pass
+  u32 blob_shader_generation = shader_manager_generation(&gp->shaders, blob_shader_variant);
+  b32 blob_shader_ready = blob_shader_generation && (blob_pass != BLOB_PASS_JUMP_FLOOD_SHADE || gp->jump_flood.shader.id);
+
+  if(blob_shader_ready && (gp->blob_shader_variant != blob_shader_variant || gp->blob_shader_generation != blob_shader_generation)) {
+    gp->blob_shader_variant = blob_shader_variant;
+    gp->blob_shader_generation = blob_shader_generation;
+    gp->blob_shader_pass = blob_pass;
+    gp->blob_shader = shader_manager_get(&gp->shaders, blob_shader_variant);
+    //int screen_rect_loc = GetShaderLocation(blob_shader, "screen_rect");
+    gp->circles_locs = gpu_circles_locs(gp->blob_shader);
+    gp->shader_dt_loc = GetShaderLocation(gp->blob_shader, "dt");
+    gp->k_loc = GetShaderLocation(gp->blob_shader, "k");
+    gp->nearest_tex_loc = GetShaderLocation(gp->blob_shader, "nearest_tex");
+    gp->gather_radius_loc = GetShaderLocation(gp->blob_shader, "gather_radius");
+  }
+
+  Texture2D atlas_tex = {0};
+  Sprite_atlas *atlas = asset_stream_get_sprite_atlas(&gp->assets, gp->sprite_atlas, &atlas_tex);
+
+  if(atlas && atlas_tex.id != gp->sprite_batch.atlas_tex.id) {
+    TraceLog(LOG_INFO, "loaded sprite atlas with %u frames and %u sprites and keyframes",
+        atlas->header->frames_count, atlas->header->entries_count);
+
+    sprite_batch_set_atlas(&gp->sprite_batch, atlas_tex, atlas->frames, atlas->header->frames_count);
+  }
 
-  return result;
 }
 
-void game_update_and_draw(Game* gp) {
-  gp->dt = Clamp(GetFrameTime(), MIN_DT, TARGET_DT);
-  gp->shader_dt += gp->dt;
+/* every look is its own specialized program, the circle count is bucketed so the loop bound is a constant */
+s32 game_blob_shader_variant(Game *gp, Blob_pass pass) {
+  s32 result = 0;
 
-  if(WindowShouldClose()) {
-    gp->quit = 1;
-    return;
+  scratch_scope() {
+    Str8 defines = (pass == BLOB_PASS_JUMP_FLOOD_STEP) ?
+      blob_shader_defines(0, 0, 0, pass) :
+      blob_shader_defines(gp->blob_blend, gp->blob_color_mix, gp->lamp_circles_max, pass);
+    result = shader_manager_variant(&gp->shaders, gp->blob_shader_program, defines);
   }
 
-  if(!gp->created_balls) {
-    gp->created_balls = 1;
-    Circle circles[] = {
-      { .color = color_from_hexcode(str8_lit("#f700ce")),
-        .center = { SCREEN_SIZE.x*0.5, SCREEN_SIZE.y*0.4, }, .radius = 110, .softness = 10.f, },
-      { .color = color_from_hexcode(str8_lit("#a400f7")),
-        .center = { SCREEN_SIZE.x*0.654, SCREEN_SIZE.y*0.66, }, .radius = 150, .softness = 10.f, },
-      { .color = color_from_hexcode(str8_lit("#f70052")),
-        .center = { SCREEN_SIZE.x*0.83, SCREEN_SIZE.y*0.5, }, .radius = 85,  .softness = 10.f,  },
-      //{ .color = GREEN , .center = {0 }, },
-      //{ .color = YELLOW, .center = {0 }, },
-    };
+  return result;
+}
 
-    gp->circles_count = ARRLEN(circles);
+Blob_pass game_blob_pass(Game *gp) {
+  b32 jump_flood =
+    gp->blob_pipeline == BLOB_PIPELINE_JUMP_FLOOD ||
+    (gp->blob_pipeline == BLOB_PIPELINE_AUTO && gp->lamp_circles_max >= BLOB_JUMP_FLOOD_MIN_CIRCLES);
 
-    Vector2 dir = {0, 1};
+  Blob_pass result = jump_flood ? BLOB_PASS_JUMP_FLOOD_SHADE : BLOB_PASS_LOOP;
+  return result;
+}
 
-    for(int i = 0; i < gp->circles_count; i++) {
-      Circle *c = &circles[i];
+/* pushed on the scratch arena, only the loop pass has a loop bound that depends on the count */
+Str8 blob_shader_defines(Blob_blend blend, Blob_color_mix color_mix, int circles_count, Blob_pass pass) {
+  s32 max_circles = BLOB_MIN_CIRCLES_BUCKET;
+  while(pass == BLOB_PASS_LOOP && max_circles < circles_count && max_circles < MAX_CIRCLES) {
+    max_circles <<= 1;
+  }
 
-      c->vel = Vector2Scale(
-          Vector2Rotate(dir, get_random_float(0, 2*PI, 30)),
-          get_random_float(300, 600, 15) );
+  Str8 result = scratch_push_str8f(
+      "#define BLOB_BLEND %i\n"
+      "#define BLOB_COLOR_MIX %i\n"
+      "#define BLOB_MAX_CIRCLES %i\n"
+      "#define BLOB_PASS %i\n",
+      blend, color_mix, max_circles, pass);
 
-      c->friction = c->radius*FRICTION_TO_RADIUS;
+  return result;
+}
 
-      c->mass = c->radius*MASS_TO_RADIUS;
+void jump_flood_set_shader(Jump_flood *jf, Shader shader) {
+  jf->shader = shader;
 
-    }
+  if(shader.id) {
+    jf->nearest_tex_loc = GetShaderLocation(shader, "nearest_tex");
+    jf->jump_loc = GetShaderLocation(shader, "jump");
+    jf->circles_locs = gpu_circles_locs(shader);
+  }
+}
+
+/* seeds are the circle centers in screen pixels, they get scaled to the target, returns the nearest circles */
+Texture2D jump_flood_run(Jump_flood *jf, GPU_circles *gc, Vector2 *seeds, int width, int height, f32 render_scale) {
+  for(int i = 0; i < ARRLEN(jf->targets); i++) {
+    RenderTexture2D *target = &jf->targets[i];
 
-    memory_copy(gp->circles_buf, circles, sizeof(circles));
+    if(target->id && (target->texture.width != width || target->texture.height != height)) {
+      UnloadRenderTexture(*target);
+      *target = (RenderTexture2D){0};
+    }
 
+    if(!target->id) {
+      *target = LoadRenderTexture(width, height);
+    }
   }
 
-  // TODO make the balls get attracted towards the top and bottom of the screen, that way they'll keep moving
-  { /* update balls */
+  int src = 0;
 
-    if(IsKeyPressed(KEY_F5)) {
-      gp->created_balls = 0;
+  prof_zone("seed") deferloop((BeginTextureMode(jf->targets[src]), ClearBackground(BLANK)), EndTextureMode()) {
+    for(int i = 0; i < gc->circles_count; i++) {
+      u32 index = (u32)i + 1;
+      DrawRectangle((int)(seeds[i].x*render_scale), (int)(seeds[i].y*render_scale), 1, 1, (Color){ (u8)index, (u8)(index >> 8), 0, 255 });
     }
+  }
 
-    if(IsKeyPressed(KEY_ESCAPE)) {
-      gp->paused = !gp->paused;
+  int jump = 1;
+  while(jump*2 < MAX(width, height)) {
+    jump <<= 1;
+  }
+
+  prof_zone("steps") for(; jump >= 1; jump >>= 1) {
+    int dst = src ^ 1;
+
+    deferloop((BeginTextureMode(jf->targets[dst]), BeginShaderMode(jf->shader)), (EndShaderMode(), EndTextureMode())) {
+      SetShaderValueTexture(jf->shader, jf->nearest_tex_loc, jf->targets[src].texture);
+      gpu_circles_set_uniforms(gc, jf->shader, jf->circles_locs, (Vector2){ (f32)width, (f32)height }, render_scale);
+      SetShaderValue(jf->shader, jf->jump_loc, &jump, SHADER_UNIFORM_INT);
+
+      DrawRectangle(0, 0, width, height, WHITE);
     }
 
-    if(gp->paused) {
-      goto update_end;
+    src = dst;
+  }
+
+  return jf->targets[src].texture;
+}
+
+void jump_flood_close(Jump_flood *jf) {
+  for(int i = 0; i < ARRLEN(jf->targets); i++) {
+    if(jf->targets[i].id) {
+      UnloadRenderTexture(jf->targets[i]);
     }
+  }
 
-    for(int i = 0; i < gp->circles_count; i++) {
+  memory_zero(jf, sizeof(*jf));
+}
 
-      Circle *c = &gp->circles_buf[i];
+void dynamic_res_init(Dynamic_res *dr) {
+  *dr = (Dynamic_res) {
+    .budget_ms = DYNAMIC_RES_BUDGET_MS,
+    .integral = 1,
+    .scale = 1,
+    .applied = 1,
+  };
+}
 
-      c->accel = (Vector2){0};
-      for(int j = 0; j < gp->circles_count; j++) {
-        if(j == i) continue;
+void dynamic_res_update(Dynamic_res *dr, f32 gpu_ms) {
+  f32 min_area = SQUARE(DYNAMIC_RES_MIN_SCALE);
 
-        Circle other_c = gp->circles_buf[j];
+  f32 error = Clamp((dr->budget_ms - gpu_ms) / dr->budget_ms, -1.0f, 1.0f);
 
-        float r_sqr = fmaxf(1e-3, Vector2DistanceSqr(c->center, other_c.center));
-        float inv_r_sqr = 1.0f/r_sqr;
-        float inv_r = sqrtf(inv_r_sqr);
-        Vector2 dir = Vector2Scale(Vector2Subtract(other_c.center, c->center), inv_r);
-        Vector2 neg_dir = Vector2Negate(dir);
-        float g = 2.2*log2(G*other_c.mass*inv_r_sqr*70.0);
-        float neg_g = 11.4*log2(G*other_c.mass*inv_r_sqr*3e-1);
-        c->accel = Vector2Add(c->accel, Vector2Scale(dir, g));
-        c->accel = Vector2Add(c->accel, Vector2Scale(neg_dir, neg_g));
+  // NOTE clamping the integral is the anti windup, otherwise a long stretch at the limit takes as long to undo
+  dr->integral = Clamp(dr->integral + DYNAMIC_RES_KI*error, min_area, 1.0f);
 
-      }
+  f32 area = Clamp(dr->integral + DYNAMIC_RES_KP*error, min_area, 1.0f);
+  dr->scale = sqrtf(area);
 
-      Vector2 a_X_dt = Vector2Scale(c->accel, gp->dt);
-      c->vel = Vector2Add(c->vel, a_X_dt);
+  if(fabsf(dr->scale - dr->applied) >= DYNAMIC_RES_STEP || (dr->scale == 1.0f && dr->applied != 1.0f)) {
+    dr->applied = CLAMP_TOP(roundf(dr->scale / DYNAMIC_RES_STEP) * DYNAMIC_RES_STEP, 1.0f);
+  }
+}
 
-      c->vel = Vector2ClampValue(c->vel, 80, 1400);
+/* sized for the applied scale, reallocated when that or the screen changes */
+RenderTexture2D dynamic_res_target(Dynamic_res *dr, int screen_width, int screen_height) {
+  int width = MAX(1, (int)((f32)screen_width*dr->applied));
+  int height = MAX(1, (int)((f32)screen_height*dr->applied));
 
-      if(Vector2LengthSqr(c->vel) > SQUARE(27.0)) {
-        c->vel = Vector2Subtract(c->vel, Vector2Scale(c->vel, c->friction*gp->dt));
-      }
-      Vector2 new_p = c->center;
-      new_p = Vector2Add(new_p, Vector2Scale(c->vel, gp->dt));
-      new_p = Vector2Add(new_p, Vector2Scale(a_X_dt, gp->dt*0.5));
+  if(dr->target.id && (dr->target.texture.width != width || dr->target.texture.height != height)) {
+    UnloadRenderTexture(dr->target);
+    dr->target = (RenderTexture2D){0};
+  }
 
-      {
+  if(!dr->target.id) {
+    dr->target = LoadRenderTexture(width, height);
+    SetTextureFilter(dr->target.texture, TEXTURE_FILTER_BILINEAR);
+  }
 
-        float r = c->radius;
-        new_p.x = fminf((float)GetScreenWidth() - r, fmaxf(r, new_p.x));
-        new_p.y = fminf((float)GetScreenHeight() - r, fmaxf(r, new_p.y));
+  return dr->target;
+}
 
-      }
+void dynamic_res_close(Dynamic_res *dr) {
+  if(dr->target.id) {
+    UnloadRenderTexture(dr->target);
+  }
 
-      c->center = new_p;
+  dr->target = (RenderTexture2D){0};
+}
 
-      {
-        Vector2 p = c->center;
-        float r = c->radius;
-        if(!(p.x > r && p.y > r && p.x < (float)GetScreenWidth() - r && p.y < (float)GetScreenHeight() - r)) {
+void glow_init(Glow *glow) {
+  *glow = (Glow) {
+    .levels = GLOW_LEVELS_DEFAULT,
+    .intensity = GLOW_INTENSITY_DEFAULT,
+  };
+}
 
-          if(p.x == r || p.x == (float)GetScreenWidth() - r) {
-            c->vel.x *= -1;
-          }
+void glow_set_shader(Glow *glow, Glow_pass pass, Shader shader) {
+  if(glow->shaders[pass].id == shader.id) {
+    return;
+  }
 
-          if(p.y == r || p.y == (float)GetScreenHeight() - r) {
-            c->vel.y *= -1;
-          }
+  glow->shaders[pass] = shader;
 
-          //c->vel = Vector2Negate(c->vel);
-          //c->vel = Vector2Rotate(c->vel, get_random_float(-PI*0.05, PI*0.05, 10));
-          //c->vel = Vector2Scale(c->vel, get_random_float(1.02, 1.1, 10));
-        }
-      }
+  if(shader.id) {
+    glow->half_pixel_locs[pass] = GetShaderLocation(shader, "half_pixel");
+    glow->intensity_locs[pass] = GetShaderLocation(shader, "intensity");
+  }
+}
 
+/* blurs what's on the source framebuffer, 0 is the back buffer, width and height are its pixels */
+void glow_run(Glow *glow, u32 source_framebuffer, int width, int height) {
+  int levels = CLAMP_TOP(CLAMP_BOT(glow->levels, 1), GLOW_MAX_LEVELS);
 
+  for(int i = 0; i < levels; i++) {
+    RenderTexture2D *mip = &glow->mips[i];
+    int mip_width = MAX(1, width >> (i + 1));
+    int mip_height = MAX(1, height >> (i + 1));
+
+    if(mip->id && (mip->texture.width != mip_width || mip->texture.height != mip_height)) {
+      UnloadRenderTexture(*mip);
+      *mip = (RenderTexture2D){0};
     }
 
-update_end:;
-  } /* update balls */
+    if(!mip->id) {
+      *mip = LoadRenderTexture(mip_width, mip_height);
+      SetTextureFilter(mip->texture, TEXTURE_FILTER_BILINEAR);
+      SetTextureWrap(mip->texture, TEXTURE_WRAP_CLAMP);
+    }
+  }
 
-  // TODO figure out how to properly account for the mac's retina display
-#if defined(OS_MAC)
-  Vector2 dpi_scale_factor = GetWindowScaleDPI();
-  float scalar_dpi_scale_factor = 0.70*Vector2Length(dpi_scale_factor);
-#elif defined(OS_LINUX)
-  Vector2 dpi_scale_factor = { 1, 1 };
-  float scalar_dpi_scale_factor = 1;
+  // NOTE the blit is the first downsample, a linear blit to half the size averages 2x2 pixels
+  prof_zone("blit") {
+    rlDrawRenderBatchActive();
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, source_framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, glow->mips[0].id);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, glow->mips[0].texture.width, glow->mips[0].texture.height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  }
+
+  prof_zone("down") for(int i = 1; i < levels; i++) {
+    deferloop(BeginTextureMode(glow->mips[i]), EndTextureMode()) {
+      Texture2D dst = glow->mips[i].texture;
+      glow_draw_pass(glow, GLOW_PASS_DOWN, glow->mips[i - 1].texture, (Rectangle){ 0, 0, (f32)dst.width, (f32)dst.height }, dst.width, dst.height, 1.0f);
+    }
+  }
+
+  prof_zone("up") for(int i = levels - 1; i > 0; i--) {
+    deferloop(BeginTextureMode(glow->mips[i - 1]), EndTextureMode()) {
+      Texture2D dst = glow->mips[i - 1].texture;
+      glow_draw_pass(glow, GLOW_PASS_UP, glow->mips[i].texture, (Rectangle){ 0, 0, (f32)dst.width, (f32)dst.height }, dst.width, dst.height, 1.0f);
+    }
+  }
+}
+
+/* the last up pass, onto whatever is bound, width and height are the pixels dst covers there */
+void glow_composite(Glow *glow, Rectangle dst, int width, int height) {
+  deferloop(BeginBlendMode(BLEND_ADDITIVE), EndBlendMode()) {
+    glow_draw_pass(glow, GLOW_PASS_UP, glow->mips[0].texture, dst, width, height, glow->intensity);
+  }
+}
+
+/* width and height are the pixels dst covers in the bound target */
+void glow_draw_pass(Glow *glow, Glow_pass pass, Texture2D src, Rectangle dst, int width, int height, f32 intensity) {
+  Shader shader = glow->shaders[pass];
+  Vector2 half_pixel = { 0.5f / (f32)width, 0.5f / (f32)height };
+
+  deferloop(BeginShaderMode(shader), EndShaderMode()) {
+    SetShaderValue(shader, glow->half_pixel_locs[pass], &half_pixel, SHADER_UNIFORM_VEC2);
+    SetShaderValue(shader, glow->intensity_locs[pass], &intensity, SHADER_UNIFORM_FLOAT);
+
+    DrawTexturePro(src, (Rectangle){ 0, 0, (f32)src.width, -(f32)src.height }, dst, (Vector2){0}, 0, WHITE);
+  }
+}
+
+void glow_close(Glow *glow) {
+  for(int i = 0; i < ARRLEN(glow->mips); i++) {
+    if(glow->mips[i].id) {
+      UnloadRenderTexture(glow->mips[i]);
+    }
+  }
+
+  memory_zero(glow->mips, sizeof(glow->mips));
+}
+
+/* called by the cradle when a watched file changes, paths look like the ones we requested */
+void game_reload_file(Game *gp, char *path) {
+  asset_stream_reload_path(&gp->assets, str8_cstr(path));
+}
+
+/* NOTE
+ * The PAIRS forces are the one O(circles^2) loop, so they're a kernel with a copy for every cpu_level().
+ * pull - push folds into one log2 of the squared distance plus a term per circle, and that log2 and the
+ * 1/sqrt are plain arithmetic instead of libm calls, which is what lets the compiler vectorize the loop.
+ * Every circle sums into SIM_FORCE_LANES partial sums that are added up in a fixed order at the end, and
+ * nothing gets contracted into FMAs, so all the copies compute the exact same bits and a lamp moves the
+ * same on every machine.
+ */
+#if COMPILER_CLANG
+#pragma STDC FP_CONTRACT OFF
+#elif COMPILER_GCC
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
 #endif
 
-  for(int i = 0; i < gp->circles_count; i++) {
+typedef void Sim_pair_forces_func(Circle *circles, f32 *xs, f32 *ys, f32 *ks, int circles_count);
+
+global Sim_pair_forces_func *sim_pair_forces_func;
+
+/* x > 0 and finite, within a couple of ulp of log2f() */
+force_inline f32 sim_log2(f32 x) {
+  union { f32 f; u32 u; } bits = { .f = x };
+
+  s32 e = (s32)(bits.u >> 23) - 127;
+  bits.u = (bits.u & 0x007fffff) | 0x3f800000;
+
+  /* the mantissa goes into [sqrt(0.5), sqrt(2)), where the atanh series below converges quickly */
+  u32 big = bits.u > 0x3fb504f3;
+  bits.u -= big << 23;
+  e += (s32)big;
+
+  f32 m = bits.f;
+  f32 t = (m - 1.0f)/(m + 1.0f);
+  f32 t2 = t*t;
+  f32 p = t*(2.88539008f + t2*(0.96179669f + t2*(0.57707802f + t2*(0.41219859f + t2*0.32059890f))));
+
+  return (f32)e + p;
+}
+
+/* x > 0, three newton steps from the bit trick guess */
+force_inline f32 sim_rsqrt(f32 x) {
+  union { f32 f; u32 u; } bits = { .f = x };
+  bits.u = 0x5f375a86 - (bits.u >> 1);
+
+  f32 y = bits.f;
+  y = y*(1.5f - 0.5f*x*y*y);
+  y = y*(1.5f - 0.5f*x*y*y);
+  y = y*(1.5f - 0.5f*x*y*y);
+
+  return y;
+}
+
+/* a circle's own term comes out as 0, so nothing has to skip it */
+force_inline void sim_pair_force(f32 cx, f32 cy, f32 x, f32 y, f32 k, f32 *ax, f32 *ay) {
+  f32 dx = x - cx;
+  f32 dy = y - cy;
+
+  /* at least 1e-3, non-negative floats order like their bits, which keeps the clamp free of float compares */
+  union { f32 f; u32 u; } r_sqr = { .f = dx*dx + dy*dy };
+  r_sqr.u = MAX(r_sqr.u, 0x3a83126f);
+
+  f32 s = (k + 9.2f*sim_log2(r_sqr.f))*sim_rsqrt(r_sqr.f);
 
-    Circle c = gp->circles_buf[i];
+  *ax += dx*s;
+  *ay += dy*s;
+}
+
+force_inline void sim_pair_forces(Circle *circles, f32 *xs, f32 *ys, f32 *ks, int circles_count) {
+  for(int i = 0; i < circles_count; i++) {
+    f32 ax[SIM_FORCE_LANES] = {0};
+    f32 ay[SIM_FORCE_LANES] = {0};
 
-    Vector4 color = ColorNormalize(c.color);
+    int j = 0;
+
+    for(; j + SIM_FORCE_LANES <= circles_count; j += SIM_FORCE_LANES) {
+      for(int l = 0; l < SIM_FORCE_LANES; l++) {
+        sim_pair_force(xs[i], ys[i], xs[j + l], ys[j + l], ks[j + l], &ax[l], &ay[l]);
+      }
+    }
 
-    Vector2 center = { c.center.x, (float)GetScreenHeight() - c.center.y };
-    center = Vector2Multiply(center, dpi_scale_factor);
+    for(int l = 0; j + l < circles_count; l++) {
+      sim_pair_force(xs[i], ys[i], xs[j + l], ys[j + l], ks[j + l], &ax[l], &ay[l]);
+    }
 
-    float radius = scalar_dpi_scale_factor*c.radius;
-    float softness = scalar_dpi_scale_factor*c.softness;
+    Vector2 accel = {0};
 
-    gp->gpu_circles_buf[i].center_x = (u16)FloatToHalf(center.x);
-    gp->gpu_circles_buf[i].center_y = (u16)FloatToHalf(center.y);
-    gp->gpu_circles_buf[i].radius   = (u16)FloatToHalf(radius);
-    gp->gpu_circles_buf[i].softness = (u16)FloatToHalf(softness);
-    gp->gpu_circles_buf[i].color_x  = (u16)FloatToHalf(color.x);
-    gp->gpu_circles_buf[i].color_y  = (u16)FloatToHalf(color.y);
-    gp->gpu_circles_buf[i].color_z  = (u16)FloatToHalf(color.z);
-    gp->gpu_circles_buf[i].color_w  = (u16)FloatToHalf(color.w);
+    for(int l = 0; l < SIM_FORCE_LANES; l++) {
+      accel.x += ax[l];
+      accel.y += ay[l];
+    }
 
+    circles[i].accel = accel;
   }
+}
 
-  UpdateTexture(gp->circles_tex, gp->gpu_circles_buf);
+/* the x86-64 baseline is SSE2, so this is the SSE2 copy there and the only one everywhere else */
+internal void sim_pair_forces_generic(Circle *circles, f32 *xs, f32 *ys, f32 *ks, int circles_count) {
+  sim_pair_forces(circles, xs, ys, ks, circles_count);
+}
+
+#if CPU_X64
+CPU_TARGET_AVX2 internal void sim_pair_forces_avx2(Circle *circles, f32 *xs, f32 *ys, f32 *ks, int circles_count) {
+  sim_pair_forces(circles, xs, ys, ks, circles_count);
+}
+
+CPU_TARGET_AVX512 internal void sim_pair_forces_avx512(Circle *circles, f32 *xs, f32 *ys, f32 *ks, int circles_count) {
+  sim_pair_forces(circles, xs, ys, ks, circles_count);
+}
+#endif
+
+#if COMPILER_CLANG
+#pragma STDC FP_CONTRACT DEFAULT
+#elif COMPILER_GCC
+#pragma GCC pop_options
+#endif
 
-  deferloop((BeginDrawing(), ClearBackground(BLACK)), EndDrawing()) {
+internal Sim_pair_forces_func* sim_pair_forces_pick(void) {
+  Sim_pair_forces_func *result = sim_pair_forces_generic;
 
-    deferloop(BeginShaderMode(gp->blob_shader), EndShaderMode()) {
+  switch(cpu_level()) {
+#if CPU_X64
+    case CPU_LEVEL_AVX512: result = sim_pair_forces_avx512; break;
+    case CPU_LEVEL_AVX2:   result = sim_pair_forces_avx2;   break;
+#endif
+    default: break;
+  }
 
-      //Vector4 screen_rect =
-      //{
-      //  0, 0,
-      //  GetScreenWidth(), GetScreenHeight(),
-      //};
+  return result;
+}
 
-      //SetShaderValue(blob_shader, screen_rect_loc, &screen_rect, SHADER_UNIFORM_VEC4);
-      SetShaderValueTexture(gp->blob_shader, gp->circles_tex_loc, gp->circles_tex);
-      SetShaderValue(gp->blob_shader, gp->circles_count_loc, &(gp->circles_count), SHADER_UNIFORM_INT);
-      SetShaderValue(gp->blob_shader, gp->shader_dt_loc, &(gp->shader_dt), SHADER_UNIFORM_FLOAT);
+/* advances the lamp by one fixed step, doesn't touch the window so it can run anywhere, field is only used with FIELD forces */
+void sim_step(Circle *circles, int circles_count, Sim_field *field, Sim_params params, f32 dt, Vector2 bounds, f32 g_scale) {
 
-      DrawRectangle(0, 0, GetScreenWidth(), GetScreenHeight(), WHITE);
-      //{
-      //  Rectangle src = { 0, 0, 1, 1 }; // use full texture
-      //  Rectangle dst = { 0, 0, GetScreenWidth(), -(float)GetScreenHeight() };
-      //  Vector2 origin = { 0, 0 };
+  f32 g = params.g*g_scale;
 
-      //  DrawTexturePro(gp->white_tex, src, dst, origin, 0.0f, WHITE);
-      //}
+  if(params.forces == SIM_FORCES_FIELD) prof_zone("field") {
+    field_step(field, circles, circles_count, dt, bounds, params.buoyancy*g_scale);
+  } else prof_zone("force") {
+    // NOTE all the forces come from the same positions, so the result doesn't depend on the order of the circles
+    Sim_pair_forces_func *pair_forces = atomic_read(&sim_pair_forces_func);
 
+    if(!pair_forces) {
+      pair_forces = sim_pair_forces_pick();
+      atomic_write(&sim_pair_forces_func, pair_forces);
     }
 
-#if 0
-    for(int i = 0; i < gp->circles_count; i++) {
-      Circle *c = &gp->circles_buf[i];
+    scratch_scope() {
+      f32 *xs = scratch_push_array_no_zero(f32, circles_count);
+      f32 *ys = scratch_push_array_no_zero(f32, circles_count);
+      f32 *ks = scratch_push_array_no_zero(f32, circles_count);
+
+      /* 2.2*log2(g*m*70/r^2) pulls and 11.4*log2(g*m*0.3/r^2) pushes, this is everything but the r^2 */
+      for(int i = 0; i < circles_count; i++) {
+        f32 gm = g*circles[i].mass;
+        xs[i] = circles[i].center.x;
+        ys[i] = circles[i].center.y;
+        ks[i] = 2.2*log2(gm*70.0) - 11.4*log2(gm*3e-1);
+      }
 
-      Str8 circle_info_text = push_str8f(gp->frame_arena,
-          "scalar vel: %f\nmass: %f\nfriction: %f\n",
-          Vector2Length(c->vel), c->mass, c->friction);
-      Vector2 circle_info_text_offset =
-      {
-        .x = 0, .y = -1,
-      };
-      if(!cached_mat_rotate_pi_over_4) {
-        cached_mat_rotate_pi_over_4 = true;
-        mat_rotate_pi_over_4 = MatrixRotate((Vector3){.z = 1}, -PI*.25);
+      pair_forces(circles, xs, ys, ks, circles_count);
+    }
+  }
+
+  prof_zone("integrate") {
+    for(int i = 0; i < circles_count; i++) {
+
+      Circle *c = &circles[i];
+
+      Vector2 a_X_dt = Vector2Scale(c->accel, dt);
+      c->vel = Vector2Add(c->vel, a_X_dt);
+
+      c->vel = Vector2ClampValue(c->vel, 80, 1400);
+
+      if(Vector2LengthSqr(c->vel) > SQUARE(27.0)) {
+        c->vel = Vector2Subtract(c->vel, Vector2Scale(c->vel, c->friction*dt));
       }
-      circle_info_text_offset = Vector2Transform(circle_info_text_offset, mat_rotate_pi_over_4);
-      Vector2 circle_info_text_pos = Vector2Add(c->center, Vector2Scale(circle_info_text_offset, c->radius*1.14));
+      Vector2 new_p = c->center;
+      new_p = Vector2Add(new_p, Vector2Scale(c->vel, dt));
+      new_p = Vector2Add(new_p, Vector2Scale(a_X_dt, dt*0.5));
 
-      DrawTextEx(GetFontDefault(), (char*)circle_info_text.s, circle_info_text_pos, 20, 2, WHITE);
+      {
 
-      DrawCircleLinesV(c->center, c->radius, GREEN);
+        float r = c->radius;
+        new_p.x = fminf(bounds.x - r, fmaxf(r, new_p.x));
+        new_p.y = fminf(bounds.y - r, fmaxf(r, new_p.y));
 
-      Vector2 accel_line_end = Vector2Add(c->center,
-          Vector2Scale(Vector2Normalize(c->accel), 100.0));
+      }
 
-      DrawLineEx(c->center, accel_line_end, 2.0, WHITE);
+      c->center = new_p;
 
-    }
-    DrawFPS(10, 10);
-#endif
+      {
+        Vector2 p = c->center;
+        float r = c->radius;
+        if(!(p.x > r && p.y > r && p.x < bounds.x - r && p.y < bounds.y - r)) {
+
+          if(p.x == r || p.x == bounds.x - r) {
+            c->vel.x *= -1;
+          }
+
+          if(p.y == r || p.y == bounds.y - r) {
+            c->vel.y *= -1;
+          }
+
+          //c->vel = Vector2Negate(c->vel);
+          //c->vel = Vector2Rotate(c->vel, rng_range_f32(rng, -PI*0.05, PI*0.05));
+          //c->vel = Vector2Scale(c->vel, rng_range_f32(rng, 1.02, 1.1));
+        }
+      }
+
+    }
+  }
+
+}
+
+void field_reset(Sim_field *field) {
+  memory_zero(field, sizeof(*field));
+
+  for(int i = 0; i < FIELD_CELLS; i++) {
+    field->temperature[i] = FIELD_T_NEUTRAL;
+  }
+}
+
+/* the ghost cells mirror the edge cells, sign -1 makes the component through that wall zero */
+internal void field_set_ghosts(f32 *a, f32 sign_x, f32 sign_y) {
+  for(int y = 1; y <= FIELD_H; y++) {
+    a[y*FIELD_STRIDE] = sign_x*a[y*FIELD_STRIDE + 1];
+    a[y*FIELD_STRIDE + FIELD_W + 1] = sign_x*a[y*FIELD_STRIDE + FIELD_W];
+  }
+
+  for(int x = 0; x < FIELD_STRIDE; x++) {
+    a[x] = sign_y*a[FIELD_STRIDE + x];
+    a[(FIELD_H + 1)*FIELD_STRIDE + x] = sign_y*a[FIELD_H*FIELD_STRIDE + x];
+  }
+}
+
+/* NOTE
+ * Jacobi iterations for x = (b + a_x*(left + right) + a_y*(up + down)) / c, which is the implicit diffusion
+ * with b the old values and the pressure solve with b the negated divergence. Every cell only reads the last
+ * iteration, so the inner loop over a row has no dependencies and vectorizes.
+ */
+internal void field_jacobi(f32 *x, f32 *b, f32 *tmp, f32 a_x, f32 a_y, f32 c, f32 sign_x, f32 sign_y) {
+  f32 inv_c = 1.0f/c;
+
+  for(int iteration = 0; iteration < FIELD_JACOBI_ITERATIONS; iteration++) {
+    for(int y = 1; y <= FIELD_H; y++) {
+      f32 *row  = x + y*FIELD_STRIDE;
+      f32 *up   = row - FIELD_STRIDE;
+      f32 *down = row + FIELD_STRIDE;
+      f32 *b_row = b + y*FIELD_STRIDE;
+      f32 *out  = tmp + y*FIELD_STRIDE;
+
+      for(int i = 1; i <= FIELD_W; i++) {
+        out[i] = (b_row[i] + a_x*(row[i - 1] + row[i + 1]) + a_y*(up[i] + down[i]))*inv_c;
+      }
+    }
+
+    for(int y = 1; y <= FIELD_H; y++) {
+      memory_copy(x + y*FIELD_STRIDE + 1, tmp + y*FIELD_STRIDE + 1, sizeof(f32)*FIELD_W);
+    }
+
+    field_set_ghosts(x, sign_x, sign_y);
+  }
+}
+
+/* gx and gy are in cells from the top left corner of the grid, so cell x's center is at x + 0.5 */
+internal f32 field_sample(f32 *a, f32 gx, f32 gy) {
+  f32 px = Clamp(gx + 0.5f, 0.0f, (f32)FIELD_W + 0.999f);
+  f32 py = Clamp(gy + 0.5f, 0.0f, (f32)FIELD_H + 0.999f);
+
+  int x = (int)px;
+  int y = (int)py;
+  f32 fx = px - (f32)x;
+  f32 fy = py - (f32)y;
+
+  f32 *row = a + y*FIELD_STRIDE + x;
+
+  f32 top    = row[0] + (row[1] - row[0])*fx;
+  f32 bottom = row[FIELD_STRIDE] + (row[FIELD_STRIDE + 1] - row[FIELD_STRIDE])*fx;
+
+  return top + (bottom - top)*fy;
+}
+
+/* semi lagrangian, every cell center is traced back along the velocity and takes whatever was there */
+internal void field_advect(f32 *dst, f32 *src, f32 *vel_x, f32 *vel_y, f32 dt_x, f32 dt_y) {
+  for(int y = 1; y <= FIELD_H; y++) {
+    for(int x = 1; x <= FIELD_W; x++) {
+      int i = y*FIELD_STRIDE + x;
+      dst[i] = field_sample(src, (f32)x - 0.5f - vel_x[i]*dt_x, (f32)y - 0.5f - vel_y[i]*dt_y);
+    }
+  }
+}
+
+void field_step(Sim_field *field, Circle *circles, int circles_count, f32 dt, Vector2 bounds, f32 buoyancy) {
+  f32 cell_x = bounds.x/(f32)FIELD_W;
+  f32 cell_y = bounds.y/(f32)FIELD_H;
+  f32 inv_cell_x = 1.0f/cell_x;
+  f32 inv_cell_y = 1.0f/cell_y;
+
+  f32 *temperature = field->temperature;
+  f32 *vel_x = field->vel_x;
+  f32 *vel_y = field->vel_y;
+
+  scratch_scope() {
+    f32 *weight = scratch_push_array(f32, FIELD_CELLS);
+    f32 *deposit_x = scratch_push_array(f32, FIELD_CELLS);
+    f32 *deposit_y = scratch_push_array(f32, FIELD_CELLS);
+    f32 *deposit_t = scratch_push_array(f32, FIELD_CELLS);
+    f32 *tmp = scratch_push_array(f32, FIELD_CELLS);
+    f32 *tmp_x = scratch_push_array(f32, FIELD_CELLS);
+    f32 *tmp_y = scratch_push_array(f32, FIELD_CELLS);
+
+    prof_zone("deposit") {
+      for(int i = 0; i < circles_count; i++) {
+        Circle *c = &circles[i];
+
+        f32 px = Clamp(c->center.x*inv_cell_x + 0.5f, 1.0f, (f32)FIELD_W - 0.001f);
+        f32 py = Clamp(c->center.y*inv_cell_y + 0.5f, 1.0f, (f32)FIELD_H - 0.001f);
+        int x = (int)px;
+        int y = (int)py;
+        f32 fx = px - (f32)x;
+        f32 fy = py - (f32)y;
+
+        f32 area = PI*SQUARE(c->radius)*inv_cell_x*inv_cell_y;
+        f32 weights[4] = { (1 - fx)*(1 - fy)*area, fx*(1 - fy)*area, (1 - fx)*fy*area, fx*fy*area };
+        int cells[4] = { y*FIELD_STRIDE + x, y*FIELD_STRIDE + x + 1, (y + 1)*FIELD_STRIDE + x, (y + 1)*FIELD_STRIDE + x + 1 };
+
+        for(int k = 0; k < 4; k++) {
+          weight[cells[k]] += weights[k];
+          deposit_x[cells[k]] += weights[k]*c->vel.x;
+          deposit_y[cells[k]] += weights[k]*c->vel.y;
+          deposit_t[cells[k]] += weights[k]*c->temperature;
+        }
+      }
+
+      // NOTE a cell a blob fully covers goes to the blob's velocity and heat at FIELD_COUPLING, less covered cells slower
+      for(int i = 0; i < FIELD_CELLS; i++) {
+        if(weight[i] > 0) {
+          f32 inv_weight = 1.0f/weight[i];
+          f32 t = Clamp(CLAMP_TOP(weight[i], 1.0f)*FIELD_COUPLING*dt, 0.0f, 1.0f);
+          vel_x[i] += (deposit_x[i]*inv_weight - vel_x[i])*t;
+          vel_y[i] += (deposit_y[i]*inv_weight - vel_y[i])*t;
+          temperature[i] += (deposit_t[i]*inv_weight - temperature[i])*t;
+        }
+      }
+    }
+
+    prof_zone("heat") {
+      f32 t = Clamp(FIELD_HEAT_RATE*dt, 0.0f, 1.0f);
+
+      f32 *top = temperature + FIELD_STRIDE;
+      f32 *bottom = temperature + FIELD_H*FIELD_STRIDE;
+
+      for(int x = 1; x <= FIELD_W; x++) {
+        top[x] -= top[x]*t;
+        bottom[x] += (1.0f - bottom[x])*t;
+      }
+
+      f32 mean = 0;
+
+      for(int y = 1; y <= FIELD_H; y++) {
+        for(int x = 1; x <= FIELD_W; x++) {
+          mean += temperature[y*FIELD_STRIDE + x];
+        }
+      }
+
+      mean *= 1.0f/(f32)(FIELD_W*FIELD_H);
+
+      // NOTE against the mean, so the liquid as a whole doesn't drift, y is down so hot goes to negative y
+      for(int y = 1; y <= FIELD_H; y++) {
+        f32 *t_row = temperature + y*FIELD_STRIDE;
+        f32 *v_row = vel_y + y*FIELD_STRIDE;
+
+        for(int x = 1; x <= FIELD_W; x++) {
+          v_row[x] -= FIELD_FLUID_BUOYANCY*(t_row[x] - mean)*dt;
+        }
+      }
+
+      field_set_ghosts(temperature, 1, 1);
+      field_set_ghosts(vel_x, -1, 1);
+      field_set_ghosts(vel_y, 1, -1);
+    }
+
+    prof_zone("advect") {
+      f32 dt_x = dt*inv_cell_x;
+      f32 dt_y = dt*inv_cell_y;
+
+      field_advect(tmp, temperature, vel_x, vel_y, dt_x, dt_y);
+      field_advect(tmp_x, vel_x, vel_x, vel_y, dt_x, dt_y);
+      field_advect(tmp_y, vel_y, vel_x, vel_y, dt_x, dt_y);
+
+      memory_copy(temperature, tmp, sizeof(f32)*FIELD_CELLS);
+      memory_copy(vel_x, tmp_x, sizeof(f32)*FIELD_CELLS);
+      memory_copy(vel_y, tmp_y, sizeof(f32)*FIELD_CELLS);
+
+      field_set_ghosts(temperature, 1, 1);
+      field_set_ghosts(vel_x, -1, 1);
+      field_set_ghosts(vel_y, 1, -1);
+    }
+
+    prof_zone("diffuse") {
+      f32 a_x = FIELD_DIFFUSION*dt*SQUARE(inv_cell_x);
+      f32 a_y = FIELD_DIFFUSION*dt*SQUARE(inv_cell_y);
+
+      memory_copy(deposit_t, temperature, sizeof(f32)*FIELD_CELLS);
+      field_jacobi(temperature, deposit_t, tmp, a_x, a_y, 1 + 2*a_x + 2*a_y, 1, 1);
+    }
+
+    prof_zone("project") {
+      f32 *divergence = deposit_x;
+      f32 *pressure = deposit_y;
+
+      memory_zero(pressure, sizeof(f32)*FIELD_CELLS);
+
+      for(int y = 1; y <= FIELD_H; y++) {
+        f32 *row_x = vel_x + y*FIELD_STRIDE;
+        f32 *row_y = vel_y + y*FIELD_STRIDE;
+        f32 *out = divergence + y*FIELD_STRIDE;
+
+        for(int x = 1; x <= FIELD_W; x++) {
+          out[x] = -(0.5f*inv_cell_x*(row_x[x + 1] - row_x[x - 1]) + 0.5f*inv_cell_y*(row_y[x + FIELD_STRIDE] - row_y[x - FIELD_STRIDE]));
+        }
+      }
+
+      f32 a_x = SQUARE(inv_cell_x);
+      f32 a_y = SQUARE(inv_cell_y);
+      field_jacobi(pressure, divergence, tmp, a_x, a_y, 2*a_x + 2*a_y, 1, 1);
+
+      for(int y = 1; y <= FIELD_H; y++) {
+        f32 *row = pressure + y*FIELD_STRIDE;
+        f32 *out_x = vel_x + y*FIELD_STRIDE;
+        f32 *out_y = vel_y + y*FIELD_STRIDE;
+
+        for(int x = 1; x <= FIELD_W; x++) {
+          out_x[x] -= 0.5f*inv_cell_x*(row[x + 1] - row[x - 1]);
+          out_y[x] -= 0.5f*inv_cell_y*(row[x + FIELD_STRIDE] - row[x - FIELD_STRIDE]);
+        }
+      }
+
+      field_set_ghosts(vel_x, -1, 1);
+      field_set_ghosts(vel_y, 1, -1);
+    }
+
+    prof_zone("sample") {
+      for(int i = 0; i < circles_count; i++) {
+        Circle *c = &circles[i];
+
+        f32 gx = c->center.x*inv_cell_x;
+        f32 gy = c->center.y*inv_cell_y;
+
+        Vector2 liquid_vel = { field_sample(vel_x, gx, gy), field_sample(vel_y, gx, gy) };
+        f32 liquid_t = field_sample(temperature, gx, gy);
+
+        c->temperature += (liquid_t - c->temperature)*Clamp(FIELD_CONDUCTION*dt*FIELD_RADIUS_REF/c->radius, 0.0f, 1.0f);
+
+        c->accel = Vector2Scale(Vector2Subtract(liquid_vel, c->vel), FIELD_DRAG);
+        c->accel.y -= buoyancy*(c->temperature - FIELD_T_NEUTRAL);
+      }
+    }
+  }
+}
+
+void sim_start(Sim *sim) {
+  atomic_write(&sim->quit, 0);
+  sim->params_mutex = os_mutex_alloc();
+  sim->thread = os_thread_launch(sim_thread, sim);
+}
+
+void sim_stop(Sim *sim) {
+  if(!sim->thread.v) {
+    return;
+  }
+
+  atomic_write(&sim->quit, 1);
+  os_thread_join(sim->thread);
+  sim->thread = (OS_handle){0};
+
+  os_mutex_release(sim->params_mutex);
+  sim->params_mutex = (OS_handle){0};
+}
+
+/* render thread */
+void sim_set_params(Sim *sim, Sim_params params) {
+  os_mutex_scope(sim->params_mutex) {
+    sim->params_in = params;
+  }
+
+  atomic_add_eval(&sim->params_version, 1);
+}
+
+/* sim thread, mass and friction are derived from the radius so they're recomputed for every circle */
+void sim_apply_params(Sim *sim) {
+  u32 version = atomic_read(&sim->params_version);
+
+  if(version == sim->params_version_seen) {
+    return;
+  }
+
+  sim->params_version_seen = version;
+
+  os_mutex_scope(sim->params_mutex) {
+    sim->params = sim->params_in;
+  }
+
+  for(int i = 0; i < sim->circles_count; i++) {
+    Circle *c = &sim->circles[i];
+    c->friction = c->radius*sim->params.friction_to_radius;
+    c->mass = c->radius*sim->params.mass_to_radius;
+  }
+}
+
+force_inline void sim_set_bounds(Sim *sim, Vector2 bounds) {
+  atomic_write(&sim->bounds, ((u64)bounds.x << 32) | (u64)bounds.y);
+}
+
+force_inline Vector2 sim_get_bounds(Sim *sim) {
+  u64 bounds = atomic_read(&sim->bounds);
+  Vector2 result = { (float)(bounds >> 32), (float)(bounds & 0xffffffff) };
+  return result;
+}
+
+/* screen_size is the whole screen, every lamp gets the same circles in its own bounds */
+void sim_reset(Sim *sim, Vector2 screen_size) {
+  sim->lamps_side = CLAMP_TOP(CLAMP_BOT((s32)atomic_read(&sim->lamps_side_requested), 1), LAMPS_SIDE_MAX);
+  sim->lamps_count = sim->lamps_side*sim->lamps_side;
+
+  Vector2 bounds = lamp_sim_bounds(sim->lamps_side, screen_size);
+
+  Circle circles[] = {
+    { .color = color_from_hexcode(str8_lit("#f700ce")),
+      .center = { bounds.x*0.5, bounds.y*0.4, }, .radius = 110, .softness = 10.f, },
+    { .color = color_from_hexcode(str8_lit("#a400f7")),
+      .center = { bounds.x*0.654, bounds.y*0.66, }, .radius = 150, .softness = 10.f, },
+    { .color = color_from_hexcode(str8_lit("#f70052")),
+      .center = { bounds.x*0.83, bounds.y*0.5, }, .radius = 85,  .softness = 10.f,  },
+    //{ .color = GREEN , .center = {0 }, },
+    //{ .color = YELLOW, .center = {0 }, },
+  };
+
+  sim->circles_count = 0;
+
+  Vector2 dir = {0, 1};
+
+  for(int l = 0; l < sim->lamps_count; l++) {
+    Sim_lamp *lamp = &sim->lamps[l];
+
+    lamp->first = sim->circles_count;
+    lamp->count = ARRLEN(circles);
+
+    for(int i = 0; i < ARRLEN(circles); i++) {
+      sim->handles[sim->circles_count] = (u16)sim->circles_count;
+      Circle *c = &sim->circles[sim->circles_count++];
+      *c = circles[i];
+
+      c->vel = Vector2Scale(
+          Vector2Rotate(dir, rng_range_f32(&sim->rng, 0, 2*PI)),
+          rng_range_f32(&sim->rng, 300, 600) );
+
+      c->friction = c->radius*sim->params.friction_to_radius;
+
+      c->mass = c->radius*sim->params.mass_to_radius;
+
+      c->temperature = rng_range_f32(&sim->rng, 0.3f, 0.7f);
+
+    }
+
+    field_reset(&sim->fields[l]);
+
+    lamp->g_scale = l == 0 ? 1.0f : rng_range_f32(&sim->rng, 0.8f, 1.2f);
+  }
+
+  Sim_state *state = &sim->states[sim->back];
+  for(int i = 0; i < sim->circles_count; i++) {
+    state->prev_centers[i] = sim->circles[i].center;
+  }
+
+  sim->step = 0;
+}
+
+/* the prev_centers of the back buffer are already filled in by whoever stepped */
+void sim_publish(Sim *sim, u64 time_ns) {
+  Sim_state *state = &sim->states[sim->back];
+
+  memory_copy(state->circles, sim->circles, sizeof(Circle)*sim->circles_count);
+  memory_copy(state->handles, sim->handles, sizeof(u16)*sim->circles_count);
+  state->circles_count = sim->circles_count;
+  memory_copy(state->lamps, sim->lamps, sizeof(Sim_lamp)*sim->lamps_count);
+  state->lamps_count = sim->lamps_count;
+  state->lamps_side = sim->lamps_side;
+  state->step = sim->step;
+  state->time_ns = time_ns;
+
+  sim->back = atomic_swap(&sim->middle, sim->back | SIM_STATE_FRESH) & SIM_STATE_INDEX_MASK;
+}
+
+/* render thread, returns the newest published state, which stays put until the next call */
+Sim_state* sim_acquire(Sim *sim) {
+  if(atomic_read(&sim->middle) & SIM_STATE_FRESH) {
+    sim->front = atomic_swap(&sim->middle, sim->front) & SIM_STATE_INDEX_MASK;
+  }
+
+  return &sim->states[sim->front];
+}
+
+/* one SIM_DT step of every lamp, the back state gets the centers from before it */
+void sim_step_lamps(Sim *sim, Vector2 screen_size) {
+  Vector2 bounds = lamp_sim_bounds(sim->lamps_side, screen_size);
+  Sim_state *state = &sim->states[sim->back];
+
+  // NOTE before the prev_centers are saved, so both are in the same order in the published state
+  if(sim->step % SIM_REORDER_STEPS == 0) prof_zone("reorder") {
+    sim_reorder(sim);
+  }
+
+  for(int i = 0; i < sim->circles_count; i++) {
+    state->prev_centers[i] = sim->circles[i].center;
+  }
+
+  for(int l = 0; l < sim->lamps_count; l++) {
+    Sim_lamp *lamp = &sim->lamps[l];
+    sim_step(sim->circles + lamp->first, lamp->count, &sim->fields[l], sim->params, SIM_DT, bounds, lamp->g_scale);
+  }
+
+  sim->step++;
+}
+
+/* within every lamp, so the lamps keep their ranges */
+void sim_reorder(Sim *sim) {
+  for(int l = 0; l < sim->lamps_count; l++) {
+    Sim_lamp *lamp = &sim->lamps[l];
+    circles_sort_morton(sim->circles + lamp->first, sim->handles + lamp->first, lamp->count, SIM_REORDER_CELL);
+  }
+}
+
+/* puts a zero bit above each of the low 16 bits */
+force_inline u32 morton_spread_bits(u32 x) {
+  x &= 0xffff;
+  x = (x | (x << 8)) & 0x00ff00ff;
+  x = (x | (x << 4)) & 0x0f0f0f0f;
+  x = (x | (x << 2)) & 0x33333333;
+  x = (x | (x << 1)) & 0x55555555;
+  return x;
+}
+
+/* LSD radix sort on the cell's Morton code, 8 bits a pass, it's stable so circles in the same cell keep their order */
+void circles_sort_morton(Circle *circles, u16 *handles, int circles_count, f32 cell_size) {
+  if(circles_count < 2) {
+    return;
+  }
+
+  scratch_scope() {
+    u32 *keys  = scratch_push_array_no_zero(u32, 2*circles_count);
+    u16 *order = scratch_push_array_no_zero(u16, 2*circles_count);
+
+    u32 *keys_in = keys, *keys_out = keys + circles_count;
+    u16 *order_in = order, *order_out = order + circles_count;
+
+    f32 inv_cell_size = 1.0f/cell_size;
+    f32 cell_max = (f32)((1 << MORTON_CELL_BITS) - 1);
+
+    for(int i = 0; i < circles_count; i++) {
+      u32 x = (u32)Clamp(circles[i].center.x*inv_cell_size, 0.0f, cell_max);
+      u32 y = (u32)Clamp(circles[i].center.y*inv_cell_size, 0.0f, cell_max);
+      keys_in[i] = morton_spread_bits(x) | (morton_spread_bits(y) << 1);
+      order_in[i] = (u16)i;
+    }
+
+    for(u32 shift = 0; shift < 2*MORTON_CELL_BITS; shift += 8) {
+      u32 offsets[256] = {0};
+
+      for(int i = 0; i < circles_count; i++) {
+        offsets[(keys_in[i] >> shift) & 0xff]++;
+      }
+
+      // NOTE a digit every key shares doesn't move anything, with a handful of cells the top pass is always one
+      if(offsets[(keys_in[0] >> shift) & 0xff] == (u32)circles_count) {
+        continue;
+      }
+
+      u32 sum = 0;
+      for(int d = 0; d < 256; d++) {
+        u32 count = offsets[d];
+        offsets[d] = sum;
+        sum += count;
+      }
+
+      for(int i = 0; i < circles_count; i++) {
+        u32 dst = offsets[(keys_in[i] >> shift) & 0xff]++;
+        keys_out[dst] = keys_in[i];
+        order_out[dst] = order_in[i];
+      }
+
+      u32 *keys_swap = keys_in;
+      keys_in = keys_out;
+      keys_out = keys_swap;
+
+      u16 *order_swap = order_in;
+      order_in = order_out;
+      order_out = order_swap;
+    }
+
+    Circle *sorted = scratch_push_array_no_zero(Circle, circles_count);
+    u16 *sorted_handles = scratch_push_array_no_zero(u16, circles_count);
+
+    for(int i = 0; i < circles_count; i++) {
+      sorted[i] = circles[order_in[i]];
+      sorted_handles[i] = handles[order_in[i]];
+    }
+
+    memory_copy(circles, sorted, sizeof(Circle)*circles_count);
+    memory_copy(handles, sorted_handles, sizeof(u16)*circles_count);
+  }
+}
+
+void sim_thread(void *arg) {
+  Sim *sim = arg;
+
+  prof_thread_name("sim");
+
+  u64 next_step_ns = os_now_ns();
+
+  while(!atomic_read(&sim->quit)) {
+    u64 now_ns = os_now_ns();
+
+    sim_apply_params(sim);
+
+    if(atomic_read(&sim->reset_requested) || atomic_read(&sim->lamps_side_requested) != (u32)sim->lamps_side) {
+      atomic_write(&sim->reset_requested, 0);
+      sim_reset(sim, sim_get_bounds(sim));
+      sim_publish(sim, now_ns);
+      next_step_ns = now_ns + SIM_STEP_NS;
+    }
+
+    if(atomic_read(&sim->paused)) {
+      next_step_ns = now_ns + SIM_STEP_NS;
+      os_sleep_ns(SIM_STEP_NS);
+      continue;
+    }
+
+    Vector2 screen_size = sim_get_bounds(sim);
+
+    int steps = 0;
+
+    for(; next_step_ns <= now_ns && steps < SIM_MAX_STEPS_PER_FRAME; steps++) prof_zone("sim step") {
+      u64 step_begin_ns = os_now_ns();
+
+      sim_step_lamps(sim, screen_size);
+
+      atomic_write(&sim->step_ns, os_now_ns() - step_begin_ns);
+
+      next_step_ns += SIM_STEP_NS;
+    }
+
+    if(steps) prof_zone("publish") {
+      sim_publish(sim, next_step_ns - SIM_STEP_NS);
+    }
+
+    // NOTE if we're too slow to keep up, drop the backlog instead of trying to catch up forever
+    if(steps == SIM_MAX_STEPS_PER_FRAME) {
+      next_step_ns = MAX(next_step_ns, now_ns);
+    }
+
+    now_ns = os_now_ns();
+    if(next_step_ns > now_ns) {
+      os_sleep_ns(next_step_ns - now_ns);
+    }
+  }
+}
+
+/* flips y, the blob shader works in gl_FragCoord space, the center is scaled back up by target_size there */
+GPU_circle gpu_circle_pack(Circle c, u8 color, Vector2 screen_size, f32 scalar_dpi_scale_factor) {
+  f32 x = Clamp(c.center.x / screen_size.x, 0.0f, 1.0f);
+  f32 y = Clamp((screen_size.y - c.center.y) / screen_size.y, 0.0f, 1.0f);
+
+  f32 radius = scalar_dpi_scale_factor*c.radius;
+
+  GPU_circle result = {
+    .center_x = (u16)(x*65535.0f + 0.5f),
+    .center_y = (u16)(y*65535.0f + 0.5f),
+    .radius   = (u16)(Clamp(radius, 0.0f, 65535.0f/16.0f)*16.0f + 0.5f),
+    .color    = color,
+  };
+
+  return result;
+}
+
+void gpu_circles_init(GPU_circles *gc) {
+  memory_zero(gc, sizeof(*gc));
+
+  // NOTE raylib has no integer formats, so this one is made by hand, integer textures can't be filtered
+  u32 id = 0;
+  glGenTextures(1, &id);
+  glBindTexture(GL_TEXTURE_2D, id);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32UI, CIRCLES_TEX_WIDTH, MAX_CIRCLES/CIRCLES_TEX_WIDTH, 0, GL_RG_INTEGER, GL_UNSIGNED_INT, gc->circles);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  gc->circles_tex = (Texture2D){ .id = id, .width = CIRCLES_TEX_WIDTH, .height = MAX_CIRCLES/CIRCLES_TEX_WIDTH, .mipmaps = 1 };
+
+  gc->lamps_side = 1;
+  gc->lamp_rects[0] = (Vector4){ 0, 0, 1, 1 };
+
+  Image palette_img = {
+    .data = gc->palette,
+    .width = PALETTE_MAX,
+    .height = 1,
+    .mipmaps = 1,
+    .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
+  };
+
+  gc->palette_tex = LoadTextureFromImage(palette_img);
+}
+
+void gpu_circles_close(GPU_circles *gc) {
+  if(gc->circles_tex.id) {
+    UnloadTexture(gc->circles_tex);
+  }
+
+  if(gc->palette_tex.id) {
+    UnloadTexture(gc->palette_tex);
+  }
+
+  memory_zero(gc, sizeof(*gc));
+}
+
+/* returns the palette index for the color, adding it if there's room */
+u8 gpu_circles_color(GPU_circles *gc, Color color) {
+  u32 key = (u32)color.r | ((u32)color.g << 8) | ((u32)color.b << 16) | ((u32)color.a << 24);
+  u32 slot = (key * 0x9e3779b1u) >> 23; /* top 9 bits, PALETTE_SLOTS is 512 */
+
+  for(;; slot = (slot + 1) % PALETTE_SLOTS) {
+    u16 entry = gc->palette_slots[slot];
+
+    if(!entry) {
+      break;
+    }
+
+    Color c = gc->palette[entry - 1];
+    if(c.r == color.r && c.g == color.g && c.b == color.b && c.a == color.a) {
+      return (u8)(entry - 1);
+    }
+  }
+
+  if(gc->palette_count < PALETTE_MAX) {
+    u8 result = (u8)gc->palette_count++;
+    gc->palette[result] = color;
+    gc->palette_slots[slot] = (u16)result + 1;
+    gc->palette_dirty = 1;
+    return result;
+  }
+
+  u8 result = 0;
+  s32 best = INT32_MAX;
+
+  for(int i = 0; i < PALETTE_MAX; i++) {
+    Color c = gc->palette[i];
+    s32 d = SQUARE((s32)c.r - color.r) + SQUARE((s32)c.g - color.g) + SQUARE((s32)c.b - color.b) + SQUARE((s32)c.a - color.a);
+
+    if(d < best) {
+      best = d;
+      result = (u8)i;
+    }
+  }
+
+  return result;
+}
+
+void gpu_circles_clear_palette(GPU_circles *gc) {
+  gc->palette_count = 0;
+  memory_zero(gc->palette_slots, sizeof(gc->palette_slots));
+}
+
+/* only the rows that have circles in them */
+void gpu_circles_upload(GPU_circles *gc) {
+  int rows = (gc->circles_count + CIRCLES_TEX_WIDTH - 1) / CIRCLES_TEX_WIDTH;
+
+  if(rows) {
+    glBindTexture(GL_TEXTURE_2D, gc->circles_tex.id);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, CIRCLES_TEX_WIDTH, rows, GL_RG_INTEGER, GL_UNSIGNED_INT, gc->circles);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  if(gc->palette_dirty) {
+    gc->palette_dirty = 0;
+    UpdateTexture(gc->palette_tex, gc->palette);
+  }
+}
+
+GPU_circles_locs gpu_circles_locs(Shader shader) {
+  GPU_circles_locs result = {
+    .circles_tex   = GetShaderLocation(shader, "circles_tex"),
+    .circles_count = GetShaderLocation(shader, "circles_count"),
+    .palette_tex   = GetShaderLocation(shader, "palette_tex"),
+    .target_size   = GetShaderLocation(shader, "target_size"),
+    .render_scale  = GetShaderLocation(shader, "render_scale"),
+    .lamps_side    = GetShaderLocation(shader, "lamps_side"),
+    .lamp_rects    = GetShaderLocation(shader, "lamp_rects"),
+    .lamp_ranges   = GetShaderLocation(shader, "lamp_ranges"),
+  };
+
+  return result;
+}
+
+/* call with the shader active, target_size is in the pixels gl_FragCoord counts, radii are scaled by render_scale */
+void gpu_circles_set_uniforms(GPU_circles *gc, Shader shader, GPU_circles_locs locs, Vector2 target_size, f32 render_scale) {
+  SetShaderValueTexture(shader, locs.circles_tex, gc->circles_tex);
+  SetShaderValueTexture(shader, locs.palette_tex, gc->palette_tex);
+  SetShaderValue(shader, locs.circles_count, &gc->circles_count, SHADER_UNIFORM_INT);
+  SetShaderValue(shader, locs.target_size, &target_size, SHADER_UNIFORM_VEC2);
+  SetShaderValue(shader, locs.render_scale, &render_scale, SHADER_UNIFORM_FLOAT);
+
+  int lamps_count = gc->lamps_side*gc->lamps_side;
+  SetShaderValue(shader, locs.lamps_side, &gc->lamps_side, SHADER_UNIFORM_INT);
+  SetShaderValueV(shader, locs.lamp_rects, gc->lamp_rects, SHADER_UNIFORM_VEC4, lamps_count);
+  SetShaderValueV(shader, locs.lamp_ranges, gc->lamp_ranges, SHADER_UNIFORM_IVEC2, lamps_count);
+}
+
+/* rect is in screen pixels, it goes to the shader as a fraction of the screen */
+void gpu_circles_set_lamp(GPU_circles *gc, int lamp, Rectangle rect, int first, int count) {
+  gc->lamp_rects[lamp] = (Vector4){ rect.x, rect.y, rect.width, rect.height };
+  gc->lamp_ranges[2*lamp + 0] = first;
+  gc->lamp_ranges[2*lamp + 1] = count;
+}
+
+/* row major from the top left, in screen pixels */
+Rectangle lamp_rect(s32 lamps_side, int lamp, Vector2 screen_size) {
+  Vector2 cell = Vector2Scale(screen_size, 1.0f/(f32)lamps_side);
+  f32 padding = lamps_side > 1 ? LAMP_PADDING : 0;
+
+  Rectangle result = {
+    .x = cell.x*((f32)(lamp % lamps_side) + padding),
+    .y = cell.y*((f32)(lamp / lamps_side) + padding),
+    .width = cell.x*(1 - 2*padding),
+    .height = cell.y*(1 - 2*padding),
+  };
+
+  return result;
+}
+
+/* every lamp is the same size, the sim gives it the screen's height */
+Vector2 lamp_sim_bounds(s32 lamps_side, Vector2 screen_size) {
+  Rectangle rect = lamp_rect(lamps_side, 0, screen_size);
+  Vector2 result = { rect.width*screen_size.y/rect.height, screen_size.y };
+  return result;
+}
+
+/* lamp sim units to screen pixels */
+f32 lamp_scale(s32 lamps_side, Vector2 screen_size) {
+  return lamp_rect(lamps_side, 0, screen_size).height / lamp_sim_bounds(lamps_side, screen_size).y;
+}
+
+/* alpha goes from the centers before the state's step to the ones after it, every circle lands at its handle,
+ * returns the most circles in any one lamp */
+int gpu_circles_pack_state(GPU_circles *gc, Sim_state *state, f32 alpha, Vector2 screen_size, Vector2 dpi_scale_factor, f32 scalar_dpi_scale_factor, Vector2 *seeds) {
+  int result = 0;
+
+  s32 lamps_side = CLAMP_BOT(state->lamps_side, 1);
+  f32 scale = lamp_scale(lamps_side, screen_size);
+
+  gc->lamps_side = lamps_side;
+
+  for(int l = 0; l < state->lamps_count; l++) {
+    Sim_lamp lamp = state->lamps[l];
+    Rectangle rect = lamp_rect(lamps_side, l, screen_size);
+
+    for(int i = lamp.first; i < lamp.first + lamp.count; i++) {
+
+      Circle c = state->circles[i];
+      u16 handle = state->handles[i];
+
+      c.center = Vector2Lerp(state->prev_centers[i], c.center, alpha);
+      c.center = Vector2Add((Vector2){ rect.x, rect.y }, Vector2Scale(c.center, scale));
+      c.radius *= scale;
+
+      u8 color = gpu_circles_color(gc, c.color);
+      gc->circles[handle] = gpu_circle_pack(c, color, screen_size, scalar_dpi_scale_factor);
+      seeds[handle] = Vector2Multiply(c.center, dpi_scale_factor);
+
+    }
+
+    rect = (Rectangle){ rect.x/screen_size.x, rect.y/screen_size.y, rect.width/screen_size.x, rect.height/screen_size.y };
+    gpu_circles_set_lamp(gc, l, rect, lamp.first, lamp.count);
+    result = MAX(result, lamp.count);
+  }
+
+  gc->circles_count = state->circles_count;
+
+  return result;
+}
+
+/* timer queries are core since 3.3, without them the timer stays zeroed and begin/end do nothing */
+void gpu_timer_init(Gpu_timer *timer) {
+  memory_zero(timer, sizeof(*timer));
+
+  if(GLAD_GL_VERSION_3_3 || GLAD_GL_ARB_timer_query) {
+    glGenQueries(GPU_TIMER_QUERIES, timer->queries);
+  }
+}
+
+void gpu_timer_close(Gpu_timer *timer) {
+  if(timer->queries[0]) {
+    glDeleteQueries(GPU_TIMER_QUERIES, timer->queries);
+  }
+
+  memory_zero(timer, sizeof(*timer));
+}
+
+/* the query from GPU_TIMER_QUERIES frames ago is almost always done by now, if it isn't we skip that sample */
+void gpu_timer_begin(Gpu_timer *timer) {
+  if(!timer->queries[0]) {
+    return;
+  }
+
+  u32 i = timer->query_index % GPU_TIMER_QUERIES;
+
+  if(timer->queries_issued[i]) {
+    GLint available = 0;
+    glGetQueryObjectiv(timer->queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+
+    if(available) {
+      GLuint64 elapsed = 0;
+      glGetQueryObjectui64v(timer->queries[i], GL_QUERY_RESULT, &elapsed);
+      timer->ms = (f32)elapsed * 1e-6f;
+      timer->samples++;
+    }
+  }
+
+  // NOTE get whatever was batched before out of the way so we only time what's inside
+  rlDrawRenderBatchActive();
+  glBeginQuery(GL_TIME_ELAPSED, timer->queries[i]);
+}
+
+void gpu_timer_end(Gpu_timer *timer) {
+  if(!timer->queries[0]) {
+    return;
+  }
+
+  rlDrawRenderBatchActive();
+  glEndQuery(GL_TIME_ELAPSED);
+
+  timer->queries_issued[timer->query_index % GPU_TIMER_QUERIES] = 1;
+  timer->query_index++;
+}
+
+void game_hud(Game *gp) {
+  Hud *hud = &gp->hud;
+
+  hud_history_push(hud, gp->hud_frame_ms, GetFrameTime() * 1e3f);
+  hud_history_push(hud, gp->hud_render_ms, gp->render_ms);
+  hud_history_push(hud, gp->hud_sim_ms, (f32)atomic_read(&gp->sim.step_ns) * 1e-6f);
+  hud_history_push(hud, gp->hud_gpu_ms, gp->blob_timer.ms);
+  hud_history_push(hud, gp->hud_glow_ms, gp->glow.enabled ? gp->glow_timer.ms : 0);
+  hud_next_frame(hud);
+
+  if(!hud_begin(hud)) {
+    return;
+  }
+
+  mu_Context *mu = hud->mu;
+
+  if(mu_begin_window_ex(mu, "perf", mu_rect(10, 10, 340, 600), MU_OPT_NOCLOSE)) {
+
+    hud_graph(hud, "frame ms", gp->hud_frame_ms, 2.0f*1e3f/(f32)TARGET_FPS, hud_frame_color);
+    hud_graph(hud, "render ms", gp->hud_render_ms, 1e3f/(f32)TARGET_FPS, hud_render_color);
+    hud_graph(hud, "sim step ms", gp->hud_sim_ms, 1e3f/(f32)SIM_HZ, hud_sim_color);
+    hud_graph(hud, gp->blob_timer.queries[0] ? "gpu blob ms" : "gpu n/a", gp->hud_gpu_ms, 1e3f/(f32)TARGET_FPS, hud_gpu_color);
+    hud_graph(hud, gp->glow_timer.queries[0] ? "gpu glow ms" : "gpu n/a", gp->hud_glow_ms, 1.0f, hud_gpu_color);
+
+    hud_stat(hud, "hud ms", "%.3f", hud->cost_ms);
+    hud_stat(hud, "circles", "%i", gp->circles_count);
+    hud_stat(hud, "lamps", "%i x %i, %i circles at most", gp->lamps_side, gp->lamps_side, gp->lamp_circles_max);
+    hud_stat(hud, "pipeline", "%s%s", blob_pipeline_names[gp->blob_pipeline],
+        gp->blob_pipeline == BLOB_PIPELINE_AUTO ? (gp->blob_shader_pass == BLOB_PASS_LOOP ? " (loop)" : " (jump flood)") : "");
+    hud_stat(hud, "render scale", gp->dynamic_res.enabled ? "%3.0f%%  wants %3.0f%%" : "off", gp->dynamic_res.applied*100.0f, gp->dynamic_res.scale*100.0f);
+    hud_stat(hud, "idle", "%u frames%s, %i fps", gp->idle_frames, gp->frame_cache_valid ? " cached" : "", gp->target_fps);
+    hud_stat(hud, "sim step", "%llu", (unsigned long long)gp->sim.states[gp->sim.front].step);
+    hud_stat(hud, "main arena", "%llu KB", (unsigned long long)arena_pos(gp->main_arena) / KB(1));
+    hud_stat(hud, "frame arena", "%llu KB", (unsigned long long)arena_pos(gp->frame_arena) / KB(1));
+    hud_stat(hud, "scratch", "%llu KB", (unsigned long long)arena_pos(context_scratch_arena) / KB(1));
+
+    if(mu_header_ex(mu, "tuning", MU_OPT_EXPANDED)) {
+      Sim_params params = gp->sim_params;
+
+      mu_layout_row(mu, 2, (int[]){ 90, -1 }, 0);
+
+      int convection = params.forces == SIM_FORCES_FIELD;
+      mu_label(mu, "");
+      mu_checkbox(mu, "convection", &convection);
+      params.forces = convection ? SIM_FORCES_FIELD : SIM_FORCES_PAIRS;
+
+      if(params.forces == SIM_FORCES_FIELD) {
+        mu_label(mu, "buoyancy");
+        mu_slider_ex(mu, &params.buoyancy, 0, 3000, 0, "%.0f", MU_OPT_ALIGNCENTER);
+      } else {
+        mu_label(mu, "G");
+        mu_slider_ex(mu, &params.g, 0, 200, 0, "%.2f", MU_OPT_ALIGNCENTER);
+      }
+
+      mu_label(mu, "mass/radius");
+      mu_slider_ex(mu, &params.mass_to_radius, 1, 1000, 0, "%.2f", MU_OPT_ALIGNCENTER);
+
+      mu_label(mu, "friction/radius");
+      mu_slider_ex(mu, &params.friction_to_radius, 0, 1e-2, 0, "%.5f", MU_OPT_ALIGNCENTER);
+
+      mu_label(mu, "k");
+      mu_slider_ex(mu, &gp->blob_k, 1, 200, 0, "%.1f", MU_OPT_ALIGNCENTER);
+
+      mu_label(mu, "gpu budget ms");
+      mu_slider_ex(mu, &gp->dynamic_res.budget_ms, 1, 33, 0, "%.1f", MU_OPT_ALIGNCENTER);
+
+      int dynamic_res = (int)gp->dynamic_res.enabled;
+      mu_label(mu, "");
+      mu_checkbox(mu, "dynamic res", &dynamic_res);
+      gp->dynamic_res.enabled = (b32)dynamic_res;
+
+      f32 glow_levels = (f32)gp->glow.levels;
+      mu_label(mu, "glow levels");
+      mu_slider_ex(mu, &glow_levels, 1, GLOW_MAX_LEVELS, 1, "%.0f", MU_OPT_ALIGNCENTER);
+      gp->glow.levels = (s32)glow_levels;
+
+      mu_label(mu, "glow intensity");
+      mu_slider_ex(mu, &gp->glow.intensity, 0, 2, 0, "%.2f", MU_OPT_ALIGNCENTER);
+
+      int glow = (int)gp->glow.enabled;
+      mu_label(mu, "");
+      mu_checkbox(mu, "glow", &glow);
+      gp->glow.enabled = (b32)glow;
+
+      if(memcmp(&params, &gp->sim_params, sizeof(params))) {
+        gp->sim_params = params;
+        sim_set_params(&gp->sim, params);
+      }
+    }
+
+    mu_end_window(mu);
+  }
+
+  hud_end(hud);
+}
+
+Color color_from_hexcode(Str8 hexcode) {
+
+  u8 components[4] = { 0, 0, 0, 0xff, };
+
+  int i = 0; 
+  if(hexcode.s[0] == '#') {
+    i++;
+  }
+  for(int c = 0; i < hexcode.len; i += 2, c++) {
+    u8 a = hexcode.s[i];
+    u8 b = hexcode.s[i+1];
+
+    components[c] = (hexdigit_to_int(a) << 4) + hexdigit_to_int(b);
+  }
+
+  Color result = { .r = components[0], .g = components[1], .b = components[2], .a = components[3] };
+
+  return result;
+}
+
+/* one full screen rect through the blob shader, into whatever target is bound */
+void game_draw_blobs(Game *gp, Texture2D nearest_tex, int width, int height, Vector2 target_size, f32 render_scale) {
+  deferloop(BeginShaderMode(gp->blob_shader), EndShaderMode()) {
+
+    //Vector4 screen_rect =
+    //{
+    //  0, 0,
+    //  GetScreenWidth(), GetScreenHeight(),
+    //};
+
+    //SetShaderValue(blob_shader, screen_rect_loc, &screen_rect, SHADER_UNIFORM_VEC4);
+    f32 k = gp->blob_k*gp->lamp_scale*render_scale;
+
+    gpu_circles_set_uniforms(&gp->gpu_circles, gp->blob_shader, gp->circles_locs, target_size, render_scale);
+    SetShaderValue(gp->blob_shader, gp->shader_dt_loc, &(gp->shader_dt), SHADER_UNIFORM_FLOAT);
+    SetShaderValue(gp->blob_shader, gp->k_loc, &k, SHADER_UNIFORM_FLOAT);
+
+    if(nearest_tex.id) {
+      f32 gather_radius = k*BLOB_GATHER_RADIUS_PER_K;
+      SetShaderValueTexture(gp->blob_shader, gp->nearest_tex_loc, nearest_tex);
+      SetShaderValue(gp->blob_shader, gp->gather_radius_loc, &gather_radius, SHADER_UNIFORM_FLOAT);
+    }
+
+    DrawRectangle(0, 0, width, height, WHITE);
+    //{
+    //  Rectangle src = { 0, 0, 1, 1 }; // use full texture
+    //  Rectangle dst = { 0, 0, GetScreenWidth(), -(float)GetScreenHeight() };
+    //  Vector2 origin = { 0, 0 };
+
+    //  DrawTexturePro(gp->white_tex, src, dst, origin, 0.0f, WHITE);
+    //}
+
+  }
+}
+
+/* blobs and sprites, everything under the HUD */
+void game_draw_scene(Game *gp, Vector2 dpi_scale_factor) {
+  if(gp->blob_shader.id) prof_zone("draw blobs") deferloop(gpu_timer_begin(&gp->blob_timer), gpu_timer_end(&gp->blob_timer)) {
+
+    Dynamic_res *dr = &gp->dynamic_res;
+    f32 render_scale = dr->enabled ? dr->applied : 1.0f;
+
+    RenderTexture2D target = {0};
+    int width = GetScreenWidth();
+    int height = GetScreenHeight();
+
+    if(dr->enabled) {
+      target = dynamic_res_target(dr, width, height);
+      width = target.texture.width;
+      height = target.texture.height;
+    }
+
+    Texture2D nearest_tex = {0};
+
+    if(gp->blob_shader_pass == BLOB_PASS_JUMP_FLOOD_SHADE) prof_zone("jump flood") {
+      nearest_tex = jump_flood_run(&gp->jump_flood, &gp->gpu_circles, gp->jump_flood_seeds, width, height, render_scale);
+    }
+
+    if(target.id) {
+      // NOTE no blending into the target, its alpha has to be the blob's alpha for the composite to blend right
+      deferloop((BeginTextureMode(target), ClearBackground(BLANK), rlDisableColorBlend()), (rlEnableColorBlend(), EndTextureMode())) {
+        game_draw_blobs(gp, nearest_tex, width, height, (Vector2){ (f32)width, (f32)height }, render_scale);
+      }
+
+      prof_zone("composite") {
+        DrawTexturePro(target.texture, (Rectangle){ 0, 0, (f32)width, -(f32)height }, SCREEN_RECT, SCREEN_TOP_LEFT, 0, WHITE);
+      }
+    } else {
+      game_draw_blobs(gp, nearest_tex, width, height, Vector2Multiply(SCREEN_SIZE, dpi_scale_factor), render_scale);
+    }
+
+  }
+
+  if(gp->glow.enabled && gp->glow.shaders[GLOW_PASS_UP].id) prof_zone("glow") deferloop(gpu_timer_begin(&gp->glow_timer), gpu_timer_end(&gp->glow_timer)) {
+    glow_run(&gp->glow, 0, GetRenderWidth(), GetRenderHeight());
+
+    // NOTE the back buffer is in screen units, the half pixel still has to be in its pixels
+    prof_zone("composite") {
+      glow_composite(&gp->glow, SCREEN_RECT, GetRenderWidth(), GetRenderHeight());
+    }
+  }
+
+  if(gp->sprite_shader.id) prof_zone("draw sprites") {
+    sprite_batch_draw(&gp->sprite_batch, gp->sprite_shader);
+  }
+}
+
+void frame_cache_capture(RenderTexture2D *cache, int width, int height) {
+  if(cache->id && (cache->texture.width != width || cache->texture.height != height)) {
+    UnloadRenderTexture(*cache);
+    *cache = (RenderTexture2D){0};
+  }
+
+  if(!cache->id) {
+    *cache = LoadRenderTexture(width, height);
+  }
+
+  rlDrawRenderBatchActive();
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cache->id);
+  glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void frame_cache_present(RenderTexture2D cache) {
+  int width = cache.texture.width;
+  int height = cache.texture.height;
+
+  rlDrawRenderBatchActive();
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, cache.id);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/* full rate while something moves, the HUD is up or frames are captured, then less and less the less there is to see */
+void game_pace_frames(Game *gp) {
+  s32 fps = TARGET_FPS;
+
+  if(IsWindowMinimized() || IsWindowHidden()) {
+    fps = HIDDEN_FPS;
+  } else if(gp->hud.visible || gp->capture.active) {
+    fps = TARGET_FPS;
+  } else if(gp->idle_frames > IDLE_FRAMES_BEFORE_THROTTLE) {
+    fps = IDLE_FPS;
+  } else if(!IsWindowFocused()) {
+    fps = UNFOCUSED_FPS;
+  }
+
+  if(fps != gp->target_fps) {
+    gp->target_fps = fps;
+    SetTargetFPS(fps);
+  }
+}
+
+void game_update_and_draw(Game* gp) {
+  u64 frame_begin_ns = os_now_ns();
+
+  gp->dt = fminf(GetFrameTime(), MIN_DT);
+  gp->shader_dt += gp->dt;
+
+  if(WindowShouldClose()) {
+    gp->quit = 1;
+    return;
+  }
+
+  prof_zone("assets") {
+    game_update_assets(gp);
+  }
+
+  sim_set_bounds(&gp->sim, SCREEN_SIZE);
+
+  if(!gp->created_balls) {
+    gp->created_balls = 1;
+    atomic_write(&gp->sim.reset_requested, 1);
+  }
+
+  { /* input */
+
+    if(IsKeyPressed(KEY_F5)) {
+      gp->created_balls = 0;
+      gpu_circles_clear_palette(&gp->gpu_circles);
+    }
+
+    if(IsKeyPressed(KEY_ESCAPE)) {
+      gp->paused = !gp->paused;
+      atomic_write(&gp->sim.paused, (u32)gp->paused);
+    }
+
+    if(IsKeyPressed(KEY_F1)) {
+      gp->blob_blend = (gp->blob_blend + 1) % BLOB_BLEND_MAX;
+    }
+
+    if(IsKeyPressed(KEY_F2)) {
+      gp->blob_color_mix = (gp->blob_color_mix + 1) % BLOB_COLOR_MIX_MAX;
+    }
+
+    if(IsKeyPressed(KEY_F3)) {
+      prof_capture(PROFILER_CAPTURE_PATH);
+    }
+
+    if(IsKeyPressed(KEY_F4)) {
+      gp->hud.visible = !gp->hud.visible;
+    }
+
+    if(IsKeyPressed(KEY_F6)) {
+      gp->blob_pipeline = (gp->blob_pipeline + 1) % BLOB_PIPELINE_MAX;
+    }
+
+    if(IsKeyPressed(KEY_F7)) {
+      gp->dynamic_res.enabled = !gp->dynamic_res.enabled;
+    }
+
+    if(IsKeyPressed(KEY_F8)) {
+      gp->glow.enabled = !gp->glow.enabled;
+    }
+
+    if(IsKeyPressed(KEY_F9)) {
+      gp->lamps_side = gp->lamps_side % LAMPS_SIDE_MAX + 1;
+      atomic_write(&gp->sim.lamps_side_requested, (u32)gp->lamps_side);
+    }
+
+    if(IsKeyPressed(KEY_F10)) {
+      if(gp->capture.active) {
+        frame_capture_end(&gp->capture);
+      } else {
+        frame_capture_begin(&gp->capture, FRAME_CAPTURE_PATH, GetRenderWidth(), GetRenderHeight());
+      }
+    }
+
+  } /* input */
+
+  // NOTE only on a new sample, the timer is read a few frames late and most frames don't bring one
+  if(gp->dynamic_res.enabled && gp->dynamic_res.samples_seen != gp->blob_timer.samples) {
+    gp->dynamic_res.samples_seen = gp->blob_timer.samples;
+    dynamic_res_update(&gp->dynamic_res, gp->blob_timer.ms);
+  }
+
+  Sim_state *state = sim_acquire(&gp->sim);
+
+  gp->circles_count = state->circles_count;
+
+  // NOTE the state is one step behind, render between it and the one before so the motion is smooth at any refresh rate
+  u64 now_ns = os_now_ns();
+  gp->sim_alpha = Clamp((f32)(now_ns - MIN(now_ns, state->time_ns)) / (f32)SIM_STEP_NS, 0.0f, 1.0f);
+
+  // TODO figure out how to properly account for the mac's retina display
+#if defined(OS_MAC)
+  Vector2 dpi_scale_factor = GetWindowScaleDPI();
+  float scalar_dpi_scale_factor = 0.70*Vector2Length(dpi_scale_factor);
+#elif defined(OS_LINUX)
+  Vector2 dpi_scale_factor = { 1, 1 };
+  float scalar_dpi_scale_factor = 1;
+#endif
+
+  prof_zone("pack") {
+    gp->lamp_circles_max = gpu_circles_pack_state(&gp->gpu_circles, state, gp->sim_alpha, SCREEN_SIZE,
+        dpi_scale_factor, scalar_dpi_scale_factor, gp->jump_flood_seeds);
+    gp->lamp_scale = lamp_scale(gp->gpu_circles.lamps_side, SCREEN_SIZE);
+  }
+
+  prof_zone("upload") {
+    gpu_circles_upload(&gp->gpu_circles);
+  }
+
+  /* before the key, the frame about to be drawn has the sprites this update moves to */
+  sprite_batch_update(&gp->sprite_batch, gp->dt);
+
+  { /* idle */
+
+    Frame_key key = {
+      .sim_step = state->step,
+      .sim_alpha = gp->sim_alpha,
+      .width = GetScreenWidth(),
+      .height = GetScreenHeight(),
+      .blob_shader_id = gp->blob_shader.id,
+      .blob_shader_generation = gp->blob_shader_generation,
+      .blob_k = gp->blob_k,
+      .render_scale = gp->dynamic_res.enabled ? gp->dynamic_res.applied : 0,
+      .sprites_revision = gp->sprite_batch.revision,
+      .glow_levels = gp->glow.enabled ? gp->glow.levels : 0,
+      .glow_intensity = gp->glow.intensity,
+    };
+
+    if(memcmp(&key, &gp->frame_key, sizeof(key))) {
+      gp->frame_key = key;
+      gp->idle_frames = 0;
+      gp->frame_cache_valid = 0;
+    } else {
+      gp->idle_frames++;
+    }
+
+    game_pace_frames(gp);
+
+  } /* idle */
+
+  prof_zone("hud") {
+    game_hud(gp);
+  }
+
+  // NOTE EndDrawing() swaps and waits for vsync, the time in "frame" that isn't in the draw zones is that
+  prof_zone("frame") deferloop((BeginDrawing(), ClearBackground(BLACK)), EndDrawing()) {
+
+    if(IsWindowMinimized() || IsWindowHidden()) {
+      // NOTE nobody sees it, only keep the events and the HUD's frame timing going
+    } else if(gp->frame_cache_valid) prof_zone("present cache") {
+      frame_cache_present(gp->frame_cache);
+    } else {
+      game_draw_scene(gp, dpi_scale_factor);
+
+      if(gp->idle_frames > 0) prof_zone("capture cache") {
+        frame_cache_capture(&gp->frame_cache, GetRenderWidth(), GetRenderHeight());
+        gp->frame_cache_valid = 1;
+      }
+    }
+
+    // NOTE the HUD isn't in the capture, hidden frames are skipped and a change of size stops it
+    if(gp->capture.active && !IsWindowMinimized() && !IsWindowHidden()) prof_zone("capture frame") {
+      if(gp->capture.width == GetRenderWidth() && gp->capture.height == GetRenderHeight()) {
+        frame_capture_frame(&gp->capture, 0);
+      } else {
+        frame_capture_end(&gp->capture);
+      }
+    }
+
+    prof_zone("draw hud") {
+      hud_draw(&gp->hud);
+    }
+
+    gp->render_ms = (f32)(os_now_ns() - frame_begin_ns) * 1e-6f;
 
     arena_clear(gp->frame_arena);
 
@@ -1,3 +1,6 @@
+#define NOB_IMPLEMENTATION
+
+#include "nob.h"
 #include "raylib.h"
 #include "raymath.h"
 #include "basic.h"
@@ -6,11 +9,19 @@
 #include "json.h"
 #include "aseprite.h"
 #include "sprite.h"
+#include "sprite_atlas.h"
 #include "array.h"
 
 
+#define ASEPRITE_DIR "./aseprite"
 #define ATLAS_IMAGE_PATH "./aseprite/atlas.png"
-#define ATLAS_METADATA_PATH "./aseprite/atlas.json"
+#define ATLAS_BINARY_PATH "./aseprite/atlas.bin"
+#define ATLAS_BINARY_TMP_PATH ATLAS_BINARY_PATH".tmp"
+#define ATLAS_CACHE_DIR "./aseprite/.cache"
+#define ATLAS_CACHE_MANIFEST_PATH ATLAS_CACHE_DIR"/manifest"
+#define SPRITE_DATA_PATH "sprite_data.c"
+
+#define ATLAS_FRAME_PADDING 1
 
 #define SOUND_DATA_PATH "./sounds/"
 
@@ -21,14 +32,63 @@ typedef struct File_frame_range {
   s64 last_frame;
 } File_frame_range;
 
+/* one .aseprite file and its cached export */
+typedef struct Atlas_source {
+  Str8 file_title;
+  Str8 path;
+  Str8 sheet_path;
+  Str8 data_path;
+  u64  hash;
+  b32  dirty;
+
+  Aseprite_atlas atlas;
+  Image sheet;
+} Atlas_source;
+
+/* a frame cut out of a source sheet, waiting to be placed in the atlas */
+typedef struct Atlas_pack_rect {
+  Atlas_source *source;
+  s64 frame_index; /* into source->atlas.frames */
+  s32 w;
+  s32 h;
+  s32 x;
+  s32 y;
+} Atlas_pack_rect;
+
+typedef struct Skyline_node {
+  s32 x;
+  s32 y;
+  s32 w;
+} Skyline_node;
+
+/* bottom left skyline packer, the atlas has a fixed width and grows downwards */
+typedef struct Skyline_packer {
+  Skyline_node *nodes;
+  s64 nodes_count;
+  s64 nodes_cap;
+  s32 width;
+  s32 height;
+} Skyline_packer;
+
 
 DECL_ARR_TYPE(File_frame_range);
+DECL_ARR_TYPE(Atlas_source);
+DECL_ARR_TYPE(Sprite_atlas_build_entry);
 DECL_SLICE_TYPE(Aseprite_atlas_frame);
 
 
 void print_json_(Arena *a, JSON_value *val, int indent);
 void print_json(JSON_value *val);
 
+b32 aseprite_atlas_from_json(Aseprite_atlas *atlas, u8 *src, s64 src_len);
+int atlas_source_compare(const void *a, const void *b);
+int atlas_pack_rect_compare(const void *a, const void *b);
+void image_blit_rgba8(Image *dst, Image src, Rectangle src_rect, int x, int y);
+
+void skyline_init(Skyline_packer *packer, Arena *a, s32 width, s64 max_rects);
+b32  skyline_find(Skyline_packer *packer, s32 w, s32 h, s64 *node_index, s32 *x, s32 *y);
+b32  skyline_pack(Skyline_packer *packer, s32 w, s32 h, s32 *x, s32 *y);
+
 Color color_from_hexcode(Str8 hexcode);
 
 
@@ -90,28 +150,157 @@ Color color_from_hexcode(Str8 hexcode) {
   return result;
 }
 
-int main(void) {
+int atlas_source_compare(const void *a, const void *b) {
+  Str8 a_title = ((Atlas_source*)a)->file_title;
+  Str8 b_title = ((Atlas_source*)b)->file_title;
 
-  context_init();
+  int result = memory_compare(a_title.s, b_title.s, MIN(a_title.len, b_title.len));
 
-  JSON_parser json_parser;
+  if(result == 0) {
+    result = (int)(a_title.len - b_title.len);
+  }
+
+  return result;
+}
+
+/* tallest first, then widest, that's what the skyline packer likes */
+int atlas_pack_rect_compare(const void *a, const void *b) {
+  Atlas_pack_rect *a_rect = (Atlas_pack_rect*)a;
+  Atlas_pack_rect *b_rect = (Atlas_pack_rect*)b;
 
-  TraceLog(LOG_INFO, "generating sprite atlas png and metadata");
-  
-  ASSERT(!system("aseprite -b ./aseprite/*.aseprite --sheet-pack --list-tags --filename-format '{title}/{frame}' --tagname-format '{title}/{tag}' --sheet "ATLAS_IMAGE_PATH" --format json-array --data "ATLAS_METADATA_PATH));
+  int result = b_rect->h - a_rect->h;
+
+  if(result == 0) {
+    result = b_rect->w - a_rect->w;
+  }
 
-  if(!FileExists(ATLAS_METADATA_PATH)) {
-    TraceLog(LOG_ERROR, "no "ATLAS_METADATA_PATH" was generated");
-    return 1;
+  /* qsort isn't stable, keep the layout deterministic */
+  if(result == 0) {
+    result = (a_rect->source > b_rect->source) - (a_rect->source < b_rect->source);
   }
 
-  if(!FileExists(ATLAS_IMAGE_PATH)) {
-    TraceLog(LOG_ERROR, "no "ATLAS_IMAGE_PATH" was generated");
-    return 1;
+  if(result == 0) {
+    result = (a_rect->frame_index > b_rect->frame_index) - (a_rect->frame_index < b_rect->frame_index);
   }
 
-  s64 src_len = 0;
-  u8 *src = LoadFileData(ATLAS_METADATA_PATH, (int*)&src_len);
+  return result;
+}
+
+/* both images must be PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, unlike ImageDraw() this copies the pixels as is */
+void image_blit_rgba8(Image *dst, Image src, Rectangle src_rect, int x, int y) {
+  ASSERT(dst->format == PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 && src.format == PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+
+  int src_x = (int)src_rect.x;
+  int src_y = (int)src_rect.y;
+  int w = (int)src_rect.width;
+  int h = (int)src_rect.height;
+
+  ASSERT(src_x >= 0 && src_y >= 0 && src_x + w <= src.width && src_y + h <= src.height);
+  ASSERT(x >= 0 && y >= 0 && x + w <= dst->width && y + h <= dst->height);
+
+  for(int row = 0; row < h; row++) {
+    u8 *dst_row = (u8*)dst->data + 4*((s64)(y + row)*dst->width + x);
+    u8 *src_row = (u8*)src.data + 4*((s64)(src_y + row)*src.width + src_x);
+    memory_copy(dst_row, src_row, 4*(s64)w);
+  }
+}
+
+void skyline_init(Skyline_packer *packer, Arena *a, s32 width, s64 max_rects) {
+  /* every placement adds at most one node */
+  packer->nodes_cap = max_rects + 1;
+  packer->nodes = push_array(a, Skyline_node, packer->nodes_cap);
+  packer->nodes[0] = (Skyline_node){ .x = 0, .y = 0, .w = width };
+  packer->nodes_count = 1;
+  packer->width = width;
+  packer->height = 0;
+}
+
+/* lowest top edge wins, ties go to the leftmost spot */
+b32 skyline_find(Skyline_packer *packer, s32 w, s32 h, s64 *node_index, s32 *x, s32 *y) {
+  b32 found = 0;
+  s32 best_top = INT32_MAX;
+
+  for(s64 i = 0; i < packer->nodes_count; i++) {
+    s32 node_x = packer->nodes[i].x;
+
+    if(node_x + w > packer->width) {
+      break;
+    }
+
+    s32 node_y = 0;
+    s32 remaining = w;
+
+    for(s64 j = i; remaining > 0; j++) {
+      ASSERT(j < packer->nodes_count);
+      node_y = MAX(node_y, packer->nodes[j].y);
+      remaining -= packer->nodes[j].w;
+    }
+
+    if(node_y + h < best_top) {
+      best_top = node_y + h;
+      *node_index = i;
+      *x = node_x;
+      *y = node_y;
+      found = 1;
+    }
+  }
+
+  return found;
+}
+
+b32 skyline_pack(Skyline_packer *packer, s32 w, s32 h, s32 *x, s32 *y) {
+  s64 index = 0;
+
+  if(!skyline_find(packer, w, h, &index, x, y)) {
+    return 0;
+  }
+
+  ASSERT(packer->nodes_count < packer->nodes_cap);
+
+  /* insert the new node, then eat whatever it covers on its right */
+  memory_copy(&packer->nodes[index + 1], &packer->nodes[index], sizeof(Skyline_node)*(packer->nodes_count - index));
+  packer->nodes[index] = (Skyline_node){ .x = *x, .y = *y + h, .w = w };
+  packer->nodes_count++;
+
+  for(s64 i = index + 1; i < packer->nodes_count;) {
+    Skyline_node *prev = &packer->nodes[i - 1];
+    Skyline_node *node = &packer->nodes[i];
+
+    s32 overlap = prev->x + prev->w - node->x;
+
+    if(overlap <= 0) {
+      break;
+    }
+
+    node->x += overlap;
+    node->w -= overlap;
+
+    if(node->w <= 0) {
+      memory_copy(&packer->nodes[i], &packer->nodes[i + 1], sizeof(Skyline_node)*(packer->nodes_count - i - 1));
+      packer->nodes_count--;
+    } else {
+      break;
+    }
+  }
+
+  for(s64 i = 0; i + 1 < packer->nodes_count;) {
+    if(packer->nodes[i].y == packer->nodes[i + 1].y) {
+      packer->nodes[i].w += packer->nodes[i + 1].w;
+      memory_copy(&packer->nodes[i + 1], &packer->nodes[i + 2], sizeof(Skyline_node)*(packer->nodes_count - i - 2));
+      packer->nodes_count--;
+    } else {
+      i++;
+    }
+  }
+
+  packer->height = MAX(packer->height, *y + h);
+
+  return 1;
+}
+
+b32 aseprite_atlas_from_json(Aseprite_atlas *atlas, u8 *src, s64 src_len) {
+
+  JSON_parser json_parser;
 
   json_init_parser(&json_parser, context_scratch_arena, src, src_len);
   JSON_value *val = json_parse(&json_parser);
@@ -124,14 +313,13 @@ int main(void) {
 
   //print_json(json_parser.root);
 
-  Aseprite_atlas *atlas = scratch_push_struct(Aseprite_atlas);
   JSON_value *frames = val->value;
 
   ASSERT(str8_match(str8_lit("frames"), frames->name));
   ASSERT(frames->kind == JSON_VALUE_KIND_ARRAY);
   ASSERT(frames->next);
 
-  TraceLog(LOG_INFO, "atlas has %li frames", frames->array_length);
+  TraceLog(LOG_DEBUG, "json has %li frames", frames->array_length);
 
   atlas->frames_count = frames->array_length;
   atlas->frames = scratch_push_array(Aseprite_atlas_frame, atlas->frames_count);
@@ -161,7 +349,7 @@ int main(void) {
 
         if(!str8_is_cident(list.first->str)) {
           TraceLog(LOG_ERROR, "file '%.*s.aseprite' has an invalid name, file names must start with a letter or underscore and be followed by any number of letters, underscores or digits", (int)list.first->str.len, list.first->str.s);
-          return 1;
+          return 0;
         }
 
         Str8 frame_index_str = list.last->str;
@@ -268,12 +456,12 @@ int main(void) {
 
               if(!str8_is_cident(list.first->str)) {
                 TraceLog(LOG_ERROR, "file '%.*s.aseprite' has an invalid name, filenames must start with a letter or underscore and be followed by any number of letters, underscores or digits", (int)list.first->str.len, list.first->str.s);
-                return 1;
+                return 0;
               }
 
               if(!str8_is_cident(list.last->str)) {
                 TraceLog(LOG_ERROR, "the tag '%.*s' in file '%.*s.aseprite' has an invalid name, tag names must start with a letter or underscore and be followed by any number of letters, underscores or digits", (int)list.last->str.len, list.last->str.s, (int)list.first->str.len, list.first->str.s);
-                return 1;
+                return 0;
               }
 
               scope_end(scope);
@@ -340,7 +528,337 @@ int main(void) {
 
   } /* populate atlas meta */
 
-  //arena_free(json_arena);
+  return 1;
+}
+
+int main(void) {
+
+  context_init();
+
+  Aseprite_atlas *atlas = scratch_push_struct(Aseprite_atlas);
+
+  Arr(Atlas_source) sources;
+  arr_init(sources, context_scratch_arena);
+
+  { /* hash aseprite files */
+
+    FilePathList files = LoadDirectoryFilesEx(ASEPRITE_DIR, ".aseprite", false);
+
+    for(int i = 0; i < files.count; i++) {
+      Atlas_source source = {0};
+
+      source.path       = scratch_push_str8_copy_cstr(files.paths[i]);
+      source.file_title = scratch_push_str8_copy_cstr(GetFileNameWithoutExt(files.paths[i]));
+      source.sheet_path = scratch_push_str8f(ATLAS_CACHE_DIR"/%S.png", source.file_title);
+      source.data_path  = scratch_push_str8f(ATLAS_CACHE_DIR"/%S.json", source.file_title);
+
+      int file_len = 0;
+      u8 *file_data = LoadFileData(files.paths[i], &file_len);
+
+      if(!file_data) {
+        TraceLog(LOG_ERROR, "failed to read '%s'", files.paths[i]);
+        return 1;
+      }
+
+      source.hash = str8_hash((Str8){ .s = file_data, .len = file_len });
+      UnloadFileData(file_data);
+
+      arr_push(sources, source);
+    }
+
+    UnloadDirectoryFiles(files);
+
+    /* keep the atlas layout independent of directory order */
+    qsort(sources.d, sources.count, sizeof(Atlas_source), atlas_source_compare);
+
+    TraceLog(LOG_INFO, "found %li .aseprite files", sources.count);
+
+  } /* hash aseprite files */
+
+  b32 atlas_dirty =
+    !FileExists(ATLAS_IMAGE_PATH) ||
+    !FileExists(ATLAS_BINARY_PATH) ||
+    !FileExists(SPRITE_DATA_PATH);
+
+  { /* diff against the cache manifest */
+
+    /* NOTE
+     *
+     * The manifest has one line per .aseprite file that was exported into ATLAS_CACHE_DIR,
+     * in the form "<content hash in hex> <file title>". A file is re-exported if its hash changed
+     * or its cached sheet or data went missing. Files that disappeared since the last run only force
+     * the merge, they don't need exporting.
+     *
+     */
+
+    s64 manifest_entries_count = 0;
+    s64 matched_entries_count = 0;
+
+    char *manifest_text = FileExists(ATLAS_CACHE_MANIFEST_PATH) ? LoadFileText(ATLAS_CACHE_MANIFEST_PATH) : 0;
+    Str8_list manifest_lines = {0};
+
+    if(manifest_text) {
+      Str8 manifest = { .s = (u8*)manifest_text, .len = memory_strlen(manifest_text) };
+      manifest_lines = str8_split_by_char(context_scratch_arena, manifest, '\n');
+      manifest_entries_count = manifest_lines.count;
+    }
+
+    for(int i = 0; i < sources.count; i++) {
+      Atlas_source *source = &sources.d[i];
+      source->dirty = 1;
+
+      for(Str8_node *node = manifest_lines.first; node; node = node->next) {
+        Str8 line = node->str;
+
+        if(line.len < 18 || line.s[16] != ' ') {
+          continue;
+        }
+
+        Str8 title = { .s = line.s + 17, .len = line.len - 17 };
+
+        if(!str8_match(title, source->file_title)) {
+          continue;
+        }
+
+        u64 hash = 0;
+        for(int c = 0; c < 16; c++) {
+          hash = (hash << 4) | (u64)hexdigit_to_int(line.s[c]);
+        }
+
+        matched_entries_count++;
+
+        if(hash == source->hash &&
+            FileExists((char*)source->sheet_path.s) &&
+            FileExists((char*)source->data_path.s)) {
+          source->dirty = 0;
+        }
+
+        break;
+      }
+
+      if(source->dirty) {
+        atlas_dirty = 1;
+      }
+    }
+
+    if(matched_entries_count != manifest_entries_count) {
+      TraceLog(LOG_INFO, "%li .aseprite files were removed", manifest_entries_count - matched_entries_count);
+      atlas_dirty = 1;
+    }
+
+    if(manifest_text) {
+      UnloadFileText(manifest_text);
+    }
+
+  } /* diff against the cache manifest */
+
+  if(!atlas_dirty) {
+    TraceLog(LOG_INFO, "sprite atlas is up to date, skipping");
+    return 0;
+  }
+
+  { /* export changed files */
+
+    if(!DirectoryExists(ATLAS_CACHE_DIR) && MakeDirectory(ATLAS_CACHE_DIR) != 0) {
+      TraceLog(LOG_ERROR, "failed to create "ATLAS_CACHE_DIR);
+      return 1;
+    }
+
+    /* NOTE one aseprite process per changed file, at most one per core */
+    s32 max_procs = os_processor_count();
+
+    Nob_Procs procs = {0};
+    Nob_Cmd cmd = {0};
+    b32 export_failed = 0;
+
+    for(int i = 0; i < sources.count; i++) {
+      Atlas_source *source = &sources.d[i];
+
+      if(!source->dirty) {
+        continue;
+      }
+
+      TraceLog(LOG_INFO, "exporting %s", source->path.s);
+
+      nob_cmd_append(&cmd,
+          "aseprite", "-b", (char*)source->path.s,
+          "--sheet-pack", "--list-tags",
+          "--filename-format", "{title}/{frame}",
+          "--tagname-format", "{title}/{tag}",
+          "--sheet", (char*)source->sheet_path.s,
+          "--format", "json-array",
+          "--data", (char*)source->data_path.s);
+
+      if(!nob_procs_append_with_flush(&procs, nob_cmd_run_async_and_reset(&cmd), max_procs)) {
+        export_failed = 1;
+      }
+    }
+
+    if(!nob_procs_wait_and_reset(&procs)) {
+      export_failed = 1;
+    }
+
+    nob_cmd_free(cmd);
+    nob_da_free(procs);
+
+    for(int i = 0; i < sources.count; i++) {
+      Atlas_source *source = &sources.d[i];
+
+      if(source->dirty && (!FileExists((char*)source->sheet_path.s) || !FileExists((char*)source->data_path.s))) {
+        TraceLog(LOG_ERROR, "aseprite failed to export '%s'", source->path.s);
+        export_failed = 1;
+      }
+    }
+
+    if(export_failed) {
+      return 1;
+    }
+
+  } /* export changed files */
+
+  { /* merge cached exports into the atlas */
+
+    TraceLog(LOG_INFO, "merging %li cached sprite sheets into "ATLAS_IMAGE_PATH, sources.count);
+
+    s64 frames_count = 0;
+    s64 frame_tags_count = 0;
+
+    for(int i = 0; i < sources.count; i++) {
+      Atlas_source *source = &sources.d[i];
+
+      int data_len = 0;
+      u8 *data = LoadFileData((char*)source->data_path.s, &data_len);
+
+      if(!data || !aseprite_atlas_from_json(&source->atlas, data, data_len)) {
+        TraceLog(LOG_ERROR, "failed to parse '%s'", source->data_path.s);
+        return 1;
+      }
+
+      UnloadFileData(data);
+
+      source->sheet = LoadImage((char*)source->sheet_path.s);
+
+      if(!IsImageValid(source->sheet)) {
+        TraceLog(LOG_ERROR, "failed to load '%s'", source->sheet_path.s);
+        return 1;
+      }
+
+      ImageFormat(&source->sheet, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+
+      frames_count += source->atlas.frames_count;
+      frame_tags_count += source->atlas.meta.frame_tags_count;
+    }
+
+    /* NOTE
+     *
+     * Every frame is cut out of its source sheet and packed on its own with a skyline packer,
+     * so the atlas layout no longer depends on how aseprite packed each file.
+     * The atlas width is the smallest power of 2 that could fit all the frames in a square,
+     * the height is whatever the packer ends up using.
+     *
+     */
+
+    Atlas_pack_rect *pack_rects = scratch_push_array(Atlas_pack_rect, frames_count);
+    s64 pack_rects_count = 0;
+    s64 total_frame_area = 0;
+    s32 max_frame_width = 1;
+
+    for(int i = 0; i < sources.count; i++) {
+      Atlas_source *source = &sources.d[i];
+
+      for(s64 j = 0; j < source->atlas.frames_count; j++) {
+        Rectangle frame = source->atlas.frames[j].frame;
+
+        Atlas_pack_rect rect =
+        {
+          .source = source,
+          .frame_index = j,
+          .w = (s32)frame.width + ATLAS_FRAME_PADDING,
+          .h = (s32)frame.height + ATLAS_FRAME_PADDING,
+        };
+
+        total_frame_area += (s64)rect.w * rect.h;
+        max_frame_width = MAX(max_frame_width, rect.w);
+        pack_rects[pack_rects_count++] = rect;
+      }
+    }
+
+    qsort(pack_rects, pack_rects_count, sizeof(Atlas_pack_rect), atlas_pack_rect_compare);
+
+    s32 atlas_width = 1;
+    while((s64)atlas_width*atlas_width < total_frame_area || atlas_width < max_frame_width) {
+      atlas_width <<= 1;
+    }
+
+    Skyline_packer packer = {0};
+    skyline_init(&packer, context_scratch_arena, atlas_width, pack_rects_count);
+
+    for(s64 i = 0; i < pack_rects_count; i++) {
+      Atlas_pack_rect *rect = &pack_rects[i];
+      b32 packed = skyline_pack(&packer, rect->w, rect->h, &rect->x, &rect->y);
+      ASSERT(packed);
+    }
+
+    s32 atlas_height = MAX(1, packer.height);
+
+    TraceLog(LOG_INFO, "packed %li frames into %ix%i, %.1f%% used", pack_rects_count, atlas_width, atlas_height,
+        100.0*(double)total_frame_area/((double)atlas_width*atlas_height));
+
+    Image atlas_image = GenImageColor(atlas_width, atlas_height, BLANK);
+
+    atlas->frames_count = frames_count;
+    atlas->frames = scratch_push_array(Aseprite_atlas_frame, frames_count);
+    atlas->meta.frame_tags_count = frame_tags_count;
+    atlas->meta.frame_tags = scratch_push_array(Aseprite_frame_tag, frame_tags_count);
+
+    for(s64 i = 0; i < pack_rects_count; i++) {
+      Atlas_pack_rect rect = pack_rects[i];
+      Aseprite_atlas_frame *frame = &rect.source->atlas.frames[rect.frame_index];
+
+      image_blit_rgba8(&atlas_image, rect.source->sheet, frame->frame, rect.x, rect.y);
+
+      frame->frame.x = (float)rect.x;
+      frame->frame.y = (float)rect.y;
+    }
+
+    s64 frame_i = 0;
+    s64 tag_i = 0;
+
+    for(int i = 0; i < sources.count; i++) {
+      Atlas_source *source = &sources.d[i];
+
+      for(s64 j = 0; j < source->atlas.frames_count; j++) {
+        atlas->frames[frame_i++] = source->atlas.frames[j];
+      }
+
+      for(s64 j = 0; j < source->atlas.meta.frame_tags_count; j++) {
+        atlas->meta.frame_tags[tag_i++] = source->atlas.meta.frame_tags[j];
+      }
+
+      if(i == 0) {
+        atlas->meta.app     = source->atlas.meta.app;
+        atlas->meta.version = source->atlas.meta.version;
+        atlas->meta.format  = source->atlas.meta.format;
+        atlas->meta.scale   = source->atlas.meta.scale;
+      }
+
+      UnloadImage(source->sheet);
+      source->sheet = (Image){0};
+    }
+
+    atlas->meta.image = str8_lit(ATLAS_IMAGE_PATH);
+    atlas->meta.size = (Vector2){ (float)atlas_width, (float)atlas_height };
+
+    TraceLog(LOG_INFO, "atlas has %li frames", atlas->frames_count);
+
+    if(!ExportImage(atlas_image, ATLAS_IMAGE_PATH)) {
+      TraceLog(LOG_ERROR, "failed to write "ATLAS_IMAGE_PATH);
+      return 1;
+    }
+
+    UnloadImage(atlas_image);
+
+  } /* merge cached exports into the atlas */
 
 
   { /* generate sprites from aseprite atlas */
@@ -370,8 +888,16 @@ int main(void) {
      * [X] If the repeats field was not set or is zero, then the animation will repeat infinitely.
      *     Apart from this, the n_repeats field of Aseprite_frame_tag is not used.
      *
+     * [X] The same frames, sprites and keyframes are also written to ATLAS_BINARY_PATH together with the atlas pixels,
+     *     see sprite_atlas.h. The game loads that at runtime, so sprite_data.c is only needed for release builds.
+     *
      */
 
+    Arena *atlas_binary_arena = arena_alloc(.size = MB(1));
+
+    Arr(Sprite_atlas_build_entry) atlas_binary_entries;
+    arr_init(atlas_binary_entries, atlas_binary_arena);
+
     { /* check keyframes only span 1 frame */
 
       for(int i = 0; i < atlas->meta.frame_tags_count; i++) {
@@ -602,6 +1128,15 @@ int main(void) {
               "%Sconst s32 SPRITE_KEYFRAME_%S_%S = %li;\n",
               keyframes_code, str8_to_upper(context_scratch_arena, tag.file_title), str8_to_upper(context_scratch_arena, tag.tag_name), abs_frame_index);
 
+        Sprite_atlas_build_entry entry =
+        {
+          .name = push_str8f(atlas_binary_arena, "%S_%S",
+              str8_to_upper(context_scratch_arena, tag.file_title), str8_to_upper(context_scratch_arena, tag.tag_name)),
+          .kind = SPRITE_ATLAS_ENTRY_KIND_KEYFRAME,
+          .keyframe = (s32)abs_frame_index,
+        };
+        arr_push(atlas_binary_entries, entry);
+
       }
 
       scratch_scope_end(scope);
@@ -637,15 +1172,25 @@ int main(void) {
         s64 tag_first_frame = range.first_frame + tag.from;
         s64 tag_last_frame = range.first_frame + tag.to;
 
+        Sprite_atlas_build_entry entry =
+        {
+          .name = push_str8f(atlas_binary_arena, "%S_%S",
+              str8_to_upper(context_scratch_arena, tag.file_title), str8_to_upper(context_scratch_arena, tag.tag_name)),
+          .kind = SPRITE_ATLAS_ENTRY_KIND_SPRITE,
+        };
+
         if(tag.to == tag.from) {
           sprites_code =
             scratch_push_str8f(
                 "%Sconst Sprite SPRITE_%S_%S = { .flags = SPRITE_FLAG_STILL, .first_frame = %li, .last_frame = %li, .total_frames = 1 };\n",
                 sprites_code, str8_to_upper(context_scratch_arena, tag.file_title), str8_to_upper(context_scratch_arena, tag.tag_name), tag_first_frame, tag_last_frame);
+
+          entry.sprite = (Sprite){ .flags = SPRITE_FLAG_STILL, .first_frame = tag_first_frame, .last_frame = tag_last_frame, .total_frames = 1 };
         } else {
           s64 fps = 1000/atlas->frames[range.first_frame].duration;
 
           Str8 flags_str = {0};
+          Sprite_flags flags = 0;
 
           switch(tag.direction) {
             case ASEPRITE_ANIM_DIR_FORWARD:
@@ -655,27 +1200,35 @@ int main(void) {
             case ASEPRITE_ANIM_DIR_REVERSE:
               {
                 flags_str = str8_lit("SPRITE_FLAG_REVERSE");
+                flags = SPRITE_FLAG_REVERSE;
               } break;
             case ASEPRITE_ANIM_DIR_PINGPONG:
               {
                 flags_str = str8_lit("SPRITE_FLAG_PINGPONG");
+                flags = SPRITE_FLAG_PINGPONG;
               } break;
             case ASEPRITE_ANIM_DIR_PINGPONG_REVERSE:
               {
                 flags_str = str8_lit("SPRITE_FLAG_PINGPONG | SPRITE_FLAG_REVERSE");
+                flags = SPRITE_FLAG_PINGPONG | SPRITE_FLAG_REVERSE;
               } break;
           }
 
           if(tag.n_repeats == 0) {
             flags_str = scratch_push_str8f("%S | SPRITE_FLAG_INFINITE_REPEAT", flags_str);
+            flags |= SPRITE_FLAG_INFINITE_REPEAT;
           }
 
           sprites_code =
             scratch_push_str8f(
                 "%Sconst Sprite SPRITE_%S_%S = { .flags = %S, .first_frame = %li, .last_frame = %li, .fps = %li, .total_frames = %li };\n",
                 sprites_code, str8_to_upper(context_scratch_arena, tag.file_title), str8_to_upper(context_scratch_arena, tag.tag_name), flags_str, tag_first_frame, tag_last_frame, fps, tag_last_frame - tag_first_frame + 1);
+
+          entry.sprite = (Sprite){ .flags = flags, .first_frame = tag_first_frame, .last_frame = tag_last_frame, .fps = fps, .total_frames = tag_last_frame - tag_first_frame + 1 };
         }
 
+        arr_push(atlas_binary_entries, entry);
+
       }
 
       for(int i = 0; i < file_frame_ranges.count; i++) {
@@ -692,11 +1245,19 @@ int main(void) {
           continue;
         }
 
+        Sprite_atlas_build_entry entry =
+        {
+          .name = str8_to_upper(atlas_binary_arena, range.file_title),
+          .kind = SPRITE_ATLAS_ENTRY_KIND_SPRITE,
+        };
+
         if(range.first_frame == range.last_frame) {
           sprites_code =
             scratch_push_str8f(
                 "%Sconst Sprite SPRITE_%S = { .flags = SPRITE_FLAG_STILL, .first_frame = %li, .last_frame = %li, .total_frames = 1 };\n",
                 sprites_code, str8_to_upper(context_scratch_arena, range.file_title), range.first_frame, range.last_frame);
+
+          entry.sprite = (Sprite){ .flags = SPRITE_FLAG_STILL, .first_frame = range.first_frame, .last_frame = range.last_frame, .total_frames = 1 };
         } else {
 
           for(s64 fi = range.first_frame; fi < range.last_frame; fi++) {
@@ -713,8 +1274,12 @@ int main(void) {
             scratch_push_str8f(
                 "%Sconst Sprite SPRITE_%S = { .flags = SPRITE_FLAG_INFINITE_REPEAT, .first_frame = %li, .last_frame = %li, .fps = %li, .total_frames = %li };\n",
                 sprites_code, str8_to_upper(context_scratch_arena, range.file_title), range.first_frame, range.last_frame, fps, range.last_frame - range.first_frame + 1);
+
+          entry.sprite = (Sprite){ .flags = SPRITE_FLAG_INFINITE_REPEAT, .first_frame = range.first_frame, .last_frame = range.last_frame, .fps = fps, .total_frames = range.last_frame - range.first_frame + 1 };
         }
 
+        arr_push(atlas_binary_entries, entry);
+
       }
 
       scope_end(scope);
@@ -728,10 +1293,61 @@ int main(void) {
           "%S\n\n/////////////////////////\n"
           "/// END GENERATED\n\n", generated_code);
 
-    SaveFileData("sprite_data.c", generated_code.s, generated_code.len);
+    SaveFileData(SPRITE_DATA_PATH, generated_code.s, generated_code.len);
+
+    { /* write binary atlas */
+
+      TraceLog(LOG_INFO, "writing binary sprite atlas with %li sprites and keyframes", atlas_binary_entries.count);
+
+      Image atlas_image = LoadImage(ATLAS_IMAGE_PATH);
+
+      if(!IsImageValid(atlas_image)) {
+        TraceLog(LOG_ERROR, "failed to load "ATLAS_IMAGE_PATH" for the binary atlas");
+        return 1;
+      }
+
+      ImageFormat(&atlas_image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+
+      Str8 atlas_binary =
+        sprite_atlas_serialize(atlas_binary_arena, sprite_frames, atlas_binary_entries.d, atlas_binary_entries.count, atlas_image);
+
+      /* NOTE
+       * A running game keeps the old atlas mapped while it streams in the new one, rewriting the file in place would
+       * truncate the pages under it. Renaming a finished copy over it swaps the directory entry and leaves the old
+       * file alive until its mapping goes away, and the rename is also what the cradle's watcher picks up.
+       */
+      if(!SaveFileData(ATLAS_BINARY_TMP_PATH, atlas_binary.s, atlas_binary.len)) {
+        TraceLog(LOG_ERROR, "failed to write "ATLAS_BINARY_TMP_PATH);
+        return 1;
+      }
+
+      if(!os_move_file(str8_lit(ATLAS_BINARY_TMP_PATH), str8_lit(ATLAS_BINARY_PATH))) {
+        TraceLog(LOG_ERROR, "failed to move "ATLAS_BINARY_TMP_PATH" to "ATLAS_BINARY_PATH);
+        return 1;
+      }
+
+      UnloadImage(atlas_image);
+
+    } /* write binary atlas */
+
+    arena_free(atlas_binary_arena);
 
   } /* generate sprites from aseprite atlas */
 
+  { /* write cache manifest */
+
+    Str8 manifest = {0};
+
+    for(int i = 0; i < sources.count; i++) {
+      manifest = scratch_push_str8f("%S%016lx %S\n", manifest, sources.d[i].hash, sources.d[i].file_title);
+    }
+
+    if(!SaveFileData(ATLAS_CACHE_MANIFEST_PATH, manifest.s, manifest.len)) {
+      TraceLog(LOG_WARNING, "failed to write "ATLAS_CACHE_MANIFEST_PATH", the next run will re-export everything");
+    }
+
+  } /* write cache manifest */
+
   scratch_clear();
 
 #if 0
@@ -839,7 +1455,5 @@ int main(void) {
 #endif
 
 
-  UnloadFileData(src);
-
   return 0;
 }
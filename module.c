@@ -5,9 +5,11 @@ void *module_close(void*);
 void *module_main(void*);
 void *module_load_assets(void*);
 void *module_unload_assets(void*);
+void  module_reload_file(void*, char*);
 
 void *module_init(void* _) {
 
+  context_init();
   return (void*)game_init();
 
 }
@@ -15,6 +17,7 @@ void *module_init(void* _) {
 void *module_close(void* gp) {
 
   game_close(gp);
+  context_close();
   return 0;
 
 }
@@ -32,8 +35,10 @@ void *module_main(void* _gp) {
 
 }
 
+// NOTE a freshly loaded module starts out with fresh thread locals, so the scratch arena lives and dies with the assets
 void *module_load_assets(void* gp) {
 
+  context_init();
   game_load_assets((Game*)gp);
   return 0;
 
@@ -42,6 +47,13 @@ void *module_load_assets(void* gp) {
 void *module_unload_assets(void* gp) {
 
   game_unload_assets((Game*)gp);
+  context_close();
   return 0;
 
 }
+
+void module_reload_file(void* gp, char *path) {
+
+  game_reload_file((Game*)gp, path);
+
+}
@@ -127,6 +127,7 @@ char vscode_settings[] =
 #endif
 
 #define METAPROGRAM_EXE "metaprogram"
+#define BENCH_EXE "bench"
 
 #if defined(OS_WINDOWS)
 #error "windows support not implemented"
@@ -343,6 +344,8 @@ int build_hot_reload(void);
 int build_hot_reload_cradle(void);
 int build_hot_reload_no_cradle(void);
 int build_release(void);
+int build_bench(void);
+int run_bench(void);
 //int build_wasm(void);
 //int build_itch(void);
 int run_tags(void);
@@ -580,7 +583,7 @@ int build_hot_reload_cradle(void) {
 
   nob_log(NOB_INFO, "building in hot reload mode");
 
-  nob_cmd_append(&cmd, CC, DEV_FLAGS, "-fPIC", "-DGAME_MODULE_PATH=\""GAME_MODULE_PATH"\"", "cradle.c", RAYLIB_DEBUG_LINK_OPTIONS, "-o", EXE, "-lm");
+  nob_cmd_append(&cmd, CC, DEV_FLAGS, "-fPIC", "-DGAME_MODULE_PATH=\""GAME_MODULE_PATH"\"", "cradle.c", RAYLIB_DEBUG_LINK_OPTIONS, "-o", EXE, "-lm", "-lpthread");
 
   if(!nob_cmd_run_sync_and_reset(&cmd)) return 0;
 
@@ -595,7 +598,7 @@ int build_hot_reload(void) {
   nob_cmd_append(&cmd, CC, DEV_FLAGS, "-fPIC", SHARED, "module.c", RAYLIB_DEBUG_LINK_OPTIONS, "-o", GAME_MODULE, "-lm");
   Nob_Proc p1 = nob_cmd_run_async_and_reset(&cmd);
 
-  nob_cmd_append(&cmd, CC, DEV_FLAGS, "-fPIC", "-DGAME_MODULE_PATH=\""GAME_MODULE_PATH"\"", "cradle.c", RAYLIB_DEBUG_LINK_OPTIONS, "-o", EXE, "-lm");
+  nob_cmd_append(&cmd, CC, DEV_FLAGS, "-fPIC", "-DGAME_MODULE_PATH=\""GAME_MODULE_PATH"\"", "cradle.c", RAYLIB_DEBUG_LINK_OPTIONS, "-o", EXE, "-lm", "-lpthread");
 
   if(!nob_cmd_run_sync_and_reset(&cmd)) return 0;
   if(!nob_proc_wait(p1)) return 0;
@@ -617,6 +620,32 @@ int build_release(void) {
   return 1;
 }
 
+/* the sim benchmark runs headless, it never opens a window, so the static raylib is fine */
+int build_bench(void) {
+  Nob_Cmd cmd = {0};
+
+  nob_log(NOB_INFO, "building sim benchmark");
+
+  ASSERT(nob_mkdir_if_not_exists("build"));
+  ASSERT(nob_mkdir_if_not_exists("./build/bench"));
+
+  nob_cmd_append(&cmd, CC, RELEASE_FLAGS, "bench.c", RAYLIB_STATIC_LINK_OPTIONS, "-o", "./build/bench/"BENCH_EXE, STATIC_BUILD_LDFLAGS, "-lpthread");
+  if(!nob_cmd_run_sync_and_reset(&cmd)) return 0;
+
+  return 1;
+}
+
+int run_bench(void) {
+  nob_log(NOB_INFO, "running sim benchmark");
+
+  Nob_Cmd cmd = {0};
+  nob_cmd_append(&cmd, "./build/bench/"BENCH_EXE);
+
+  if(!nob_cmd_run_sync(cmd)) return 0;
+
+  return 1;
+}
+
 #if 0
 int build_wasm(void) {
   Nob_Cmd cmd = {0};
@@ -774,6 +803,7 @@ int main(int argc, char **argv) {
   run_tags();
 
   //if(!build_release()) return 1;
+  //if(!build_bench() || !run_bench()) return 1;
   //if(!build_itch()) return 1;
   //if(!build_wasm()) return 1;
   if(!build_hot_reload_no_cradle()) return 1;
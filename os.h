@@ -20,6 +20,8 @@ typedef enum OS_kind {
 
 OS_kind os_kind(void);
 
+s32 os_processor_count(void);
+
 void* os_alloc(u64 size);
 void  os_free(void *ptr);
 
@@ -30,6 +32,38 @@ b32 os_set_current_dir_cstr(char *dir_path_cstr);
 b32 os_move_file(Str8 old_path, Str8 new_path);
 b32 os_remove_file(Str8 path);
 
+// NOTE read only mapping, the returned pointer stays valid until os_unmap_file()
+void* os_map_file(Str8 path, u64 *size);
+void  os_unmap_file(void *ptr, u64 size);
+
+// NOTE monotonic, only good for measuring intervals
+u64  os_now_ns(void);
+void os_sleep_ns(u64 ns);
+
+// NOTE threads get their own scratch arena, context_init() and context_close() are called for you
+typedef struct OS_handle OS_handle;
+struct OS_handle {
+  u64 v;
+};
+
+typedef void OS_thread_func(void *arg);
+
+OS_handle os_thread_launch(OS_thread_func *func, void *arg);
+b32       os_thread_join(OS_handle thread);
+
+OS_handle os_mutex_alloc(void);
+void      os_mutex_release(OS_handle mutex);
+void      os_mutex_lock(OS_handle mutex);
+void      os_mutex_unlock(OS_handle mutex);
+
+OS_handle os_cond_alloc(void);
+void      os_cond_release(OS_handle cond);
+void      os_cond_wait(OS_handle cond, OS_handle mutex);
+void      os_cond_signal(OS_handle cond);
+void      os_cond_broadcast(OS_handle cond);
+
+#define os_mutex_scope(mutex) deferloop(os_mutex_lock(mutex), os_mutex_unlock(mutex))
+
 
 #endif
 
@@ -44,6 +78,11 @@ b32 os_remove_file(Str8 path);
 
 #include <limits.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <time.h>
 
 #define OS_PATH_LEN PATH_MAX
 
@@ -55,6 +94,11 @@ OS_kind os_kind(void) {
 
 #include <limits.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <time.h>
 
 #define OS_PATH_LEN PATH_MAX
 
@@ -66,6 +110,11 @@ OS_kind os_kind(void) {
 
 #include <limits.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <time.h>
 #include <sys/param.h>
 
 #define OS_PATH_LEN MAXPATHLEN
@@ -105,6 +154,11 @@ void os_free(void *ptr) {
   free(ptr);
 }
 
+s32 os_processor_count(void) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (s32)MAX(n, 1);
+}
+
 
 Str8 os_get_current_dir(void) {
   size_t buf_size = OS_PATH_LEN;
@@ -165,10 +219,154 @@ b32 os_remove_file(Str8 path) {
   return result;
 }
 
+void* os_map_file(Str8 path, u64 *size) {
+  void *result = 0;
+  *size = 0;
+
+  scratch_scope() {
+    const char *path_cstr = scratch_push_cstr_copy_str8(path);
+
+    int fd = open(path_cstr, O_RDONLY);
+
+    if(fd >= 0) {
+      struct stat st;
+
+      if(fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *p = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if(p != MAP_FAILED) {
+          result = p;
+          *size = (u64)st.st_size;
+        }
+      }
+
+      /* the mapping keeps its own reference to the file */
+      close(fd);
+    }
+  }
+
+  return result;
+}
+
+void os_unmap_file(void *ptr, u64 size) {
+  if(ptr) {
+    munmap(ptr, (size_t)size);
+  }
+}
+
+u64 os_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec*BILLION(1ull) + (u64)ts.tv_nsec;
+}
+
+void os_sleep_ns(u64 ns) {
+  struct timespec ts = { .tv_sec = (time_t)(ns / BILLION(1ull)), .tv_nsec = (long)(ns % BILLION(1ull)) };
+  while(nanosleep(&ts, &ts) < 0) {}
+}
+
+typedef struct OS_thread_start OS_thread_start;
+struct OS_thread_start {
+  OS_thread_func *func;
+  void *arg;
+};
+
+internal void* os_thread_entry(void *p) {
+  OS_thread_start start = *(OS_thread_start*)p;
+  free(p);
+
+  context_init();
+  start.func(start.arg);
+  context_close();
+
+  return 0;
+}
+
+OS_handle os_thread_launch(OS_thread_func *func, void *arg) {
+  OS_handle result = {0};
+
+  OS_thread_start *start = malloc(sizeof(OS_thread_start));
+  start->func = func;
+  start->arg = arg;
+
+  pthread_t thread;
+  if(pthread_create(&thread, 0, os_thread_entry, start) == 0) {
+    result.v = (u64)(uintptr_t)thread;
+  } else {
+    free(start);
+  }
+
+  return result;
+}
+
+b32 os_thread_join(OS_handle thread) {
+  b32 result = 0;
+
+  if(thread.v) {
+    result = pthread_join((pthread_t)(uintptr_t)thread.v, 0) == 0;
+  }
+
+  return result;
+}
+
+OS_handle os_mutex_alloc(void) {
+  pthread_mutex_t *mutex = malloc(sizeof(pthread_mutex_t));
+  pthread_mutex_init(mutex, 0);
+  OS_handle result = { (u64)(uintptr_t)mutex };
+  return result;
+}
+
+void os_mutex_release(OS_handle mutex) {
+  if(mutex.v) {
+    pthread_mutex_destroy((pthread_mutex_t*)(uintptr_t)mutex.v);
+    free((void*)(uintptr_t)mutex.v);
+  }
+}
+
+void os_mutex_lock(OS_handle mutex) {
+  pthread_mutex_lock((pthread_mutex_t*)(uintptr_t)mutex.v);
+}
+
+void os_mutex_unlock(OS_handle mutex) {
+  pthread_mutex_unlock((pthread_mutex_t*)(uintptr_t)mutex.v);
+}
+
+OS_handle os_cond_alloc(void) {
+  pthread_cond_t *cond = malloc(sizeof(pthread_cond_t));
+  pthread_cond_init(cond, 0);
+  OS_handle result = { (u64)(uintptr_t)cond };
+  return result;
+}
+
+void os_cond_release(OS_handle cond) {
+  if(cond.v) {
+    pthread_cond_destroy((pthread_cond_t*)(uintptr_t)cond.v);
+    free((void*)(uintptr_t)cond.v);
+  }
+}
+
+void os_cond_wait(OS_handle cond, OS_handle mutex) {
+  pthread_cond_wait((pthread_cond_t*)(uintptr_t)cond.v, (pthread_mutex_t*)(uintptr_t)mutex.v);
+}
+
+void os_cond_signal(OS_handle cond) {
+  pthread_cond_signal((pthread_cond_t*)(uintptr_t)cond.v);
+}
+
+void os_cond_broadcast(OS_handle cond) {
+  pthread_cond_broadcast((pthread_cond_t*)(uintptr_t)cond.v);
+}
+
 #elif defined(OS_WINDOWS)
 
 #error "windows support not implemented"
 
+s32 os_processor_count(void) {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (s32)MAX(info.dwNumberOfProcessors, 1);
+}
+
 Str8 os_get_current_dir(void) {
   DWORD buf_size = GetCurrentDirectory(0, NULL);
   ASSERT(buf_size > 0);
@@ -215,6 +413,43 @@ b32 os_remove_file(Str8 path) {
   return result;
 }
 
+void* os_map_file(Str8 path, u64 *size) {
+  void *result = 0;
+  *size = 0;
+
+  scratch_scope() {
+    const char *path_cstr = scratch_push_cstr_copy_str8(path);
+
+    HANDLE file = CreateFileA(path_cstr, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+
+    if(file != INVALID_HANDLE_VALUE) {
+      LARGE_INTEGER file_size;
+
+      if(GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+
+        if(mapping) {
+          result = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+          if(result) {
+            *size = (u64)file_size.QuadPart;
+          }
+          CloseHandle(mapping);
+        }
+      }
+
+      CloseHandle(file);
+    }
+  }
+
+  return result;
+}
+
+void os_unmap_file(void *ptr, u64 size) {
+  if(ptr) {
+    UnmapViewOfFile(ptr);
+  }
+}
+
 #else
 
 #error "unsupported operating system"
@@ -0,0 +1,252 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+
+#include "basic.h"
+#include "arena.h"
+#include "os.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+/* NOTE
+ *
+ * Frame profiler. Wrap code in prof_zone("name") { ... } and every pass through it records a begin and end
+ * timestamp into the calling thread's ring buffer. Each thread gets its buffer on its first zone, the
+ * buffers come from the profiler's arena and are linked into a list so prof_capture() can walk them all.
+ *
+ * Zone names have to be string literals, or at least outlive the profiler, since only the pointer is kept.
+ *
+ * Recording never takes a lock, a thread only ever writes its own buffer and bumps its head afterwards.
+ * prof_capture() reads the buffers while they're being written, so the oldest few events of a capture can
+ * be torn on a busy thread. That's fine for looking at frames.
+ *
+ * Timestamps are raw cpu ticks (rdtsc, cntvct_el0 on arm), they get converted with a tick rate measured
+ * between prof_init() and the capture.
+ *
+ * Build with -DPROFILER_ENABLED=0 to compile every zone down to nothing.
+ *
+ * Under hot reload the buffers belong to the module, prof_close() has to run after every thread that
+ * records has been stopped.
+ *
+ */
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+#define PROF_EVENTS_PER_THREAD KB(16)
+#define PROF_THREAD_NAME_MAX   32
+
+typedef struct Prof_event Prof_event;
+struct Prof_event {
+  char *name;
+  u64 begin;
+  u64 end;
+};
+
+typedef struct Prof_thread Prof_thread;
+struct Prof_thread {
+  Prof_thread *next;
+  u32 id;
+  char name[PROF_THREAD_NAME_MAX];
+
+  Prof_event *events;
+  u64 head; /* total events written, the ring index is head % PROF_EVENTS_PER_THREAD */
+};
+
+typedef struct Profiler Profiler;
+struct Profiler {
+  b32 initialized;
+
+  Arena *arena;
+  OS_handle mutex;
+
+  Prof_thread *threads; /* pushed at the front, read without the lock */
+  u32 threads_count;
+
+  u64 init_ticks;
+  u64 init_ns;
+};
+
+#if PROFILER_ENABLED
+
+#define prof_zone(name) \
+  for(u64 __prof_begin__ = prof_timestamp(), __prof_i__ = 0; !__prof_i__; __prof_i__ += 1, prof_record((name), __prof_begin__, prof_timestamp()))
+
+#else
+
+#define prof_zone(name) for(int __prof_i__ = 0; !__prof_i__; __prof_i__ += 1)
+
+#endif
+
+void prof_init(void);
+void prof_close(void);
+void prof_thread_name(char *name);
+void prof_record(char *name, u64 begin, u64 end);
+b32  prof_capture(char *path);
+
+force_inline u64 prof_timestamp(void);
+
+
+/* * * * * * * * * * *
+ * function bodies
+ */
+
+force_inline u64 prof_timestamp(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  u64 result;
+  __asm__ volatile("mrs %0, cntvct_el0" : "=r"(result));
+  return result;
+#else
+  return os_now_ns();
+#endif
+}
+
+
+#ifdef _UNITY_BUILD_
+#define PROFILER_IMPL
+#endif
+
+#ifdef PROFILER_IMPL
+
+Profiler profiler;
+
+thread_static Prof_thread *prof_this_thread;
+
+internal Prof_thread* prof_get_thread(void) {
+  if(prof_this_thread) {
+    return prof_this_thread;
+  }
+
+  os_mutex_scope(profiler.mutex) {
+    Prof_thread *thread = push_struct(profiler.arena, Prof_thread);
+    thread->events = push_array_no_zero(profiler.arena, Prof_event, PROF_EVENTS_PER_THREAD);
+    thread->id = ++profiler.threads_count;
+    snprintf(thread->name, sizeof(thread->name), "thread %u", thread->id);
+
+    thread->next = profiler.threads;
+    atomic_write(&profiler.threads, thread);
+
+    prof_this_thread = thread;
+  }
+
+  return prof_this_thread;
+}
+
+void prof_init(void) {
+  if(!PROFILER_ENABLED || profiler.initialized) {
+    return;
+  }
+
+  profiler = (Profiler) {
+    .arena = arena_alloc(.size = MB(1)),
+    .mutex = os_mutex_alloc(),
+    .init_ticks = prof_timestamp(),
+    .init_ns = os_now_ns(),
+  };
+
+  prof_this_thread = 0;
+
+  atomic_write(&profiler.initialized, 1);
+}
+
+void prof_close(void) {
+  if(!profiler.initialized) {
+    return;
+  }
+
+  atomic_write(&profiler.initialized, 0);
+
+  arena_free(profiler.arena);
+  os_mutex_release(profiler.mutex);
+
+  memory_zero(&profiler, sizeof(profiler));
+  prof_this_thread = 0;
+}
+
+void prof_thread_name(char *name) {
+  if(!atomic_read(&profiler.initialized)) {
+    return;
+  }
+
+  Prof_thread *thread = prof_get_thread();
+  snprintf(thread->name, sizeof(thread->name), "%s", name);
+}
+
+void prof_record(char *name, u64 begin, u64 end) {
+  if(!atomic_read(&profiler.initialized)) {
+    return;
+  }
+
+  Prof_thread *thread = prof_get_thread();
+
+  Prof_event *event = &thread->events[thread->head % PROF_EVENTS_PER_THREAD];
+  event->name = name;
+  event->begin = begin;
+  event->end = end;
+
+  atomic_write(&thread->head, thread->head + 1);
+}
+
+/* writes everything that's still in the ring buffers as Chrome trace event JSON, open it in Perfetto or chrome://tracing */
+b32 prof_capture(char *path) {
+  b32 result = 0;
+
+  if(!atomic_read(&profiler.initialized)) {
+    return result;
+  }
+
+  u64 ticks = prof_timestamp() - profiler.init_ticks;
+  u64 ns = os_now_ns() - profiler.init_ns;
+
+  f64 us_per_tick = ticks ? ((f64)ns / (f64)ticks) * 1e-3 : 0;
+
+  FILE *file = fopen(path, "w");
+
+  if(file) {
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    b32 first = 1;
+
+    for(Prof_thread *thread = atomic_read(&profiler.threads); thread; thread = thread->next) {
+      fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+          first ? "" : ",\n", thread->id, thread->name);
+      first = 0;
+
+      u64 head = atomic_read(&thread->head);
+      u64 count = MIN(head, PROF_EVENTS_PER_THREAD);
+
+      for(u64 i = head - count; i < head; i++) {
+        Prof_event event = thread->events[i % PROF_EVENTS_PER_THREAD];
+
+        f64 ts = (f64)(event.begin - profiler.init_ticks) * us_per_tick;
+        f64 dur = (f64)(event.end - event.begin) * us_per_tick;
+
+        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            event.name, thread->id, ts, dur);
+      }
+    }
+
+    fprintf(file, "\n]}\n");
+
+    result = !ferror(file);
+    result &= fclose(file) == 0;
+  }
+
+  if(result) {
+    TraceLog(LOG_INFO, "wrote profiler capture to %s", path);
+  } else {
+    TraceLog(LOG_ERROR, "failed to write profiler capture to %s", path);
+  }
+
+  return result;
+}
+
+#endif
+
+#endif
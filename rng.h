@@ -0,0 +1,158 @@
+#ifndef JLIB_RNG_H
+#define JLIB_RNG_H
+
+
+#include "basic.h"
+
+
+// NOTE
+// PCG32 (pcg-random.org), 64 bits of state, 32 bits out. All the state is explicit, there's no global
+// generator, so two runs seeded the same way produce the same numbers on any platform.
+//
+// The stream picks one of 2^63 independent sequences for the same seed, give every thread its own.
+//
+// The rng_fill_*() functions run RNG_LANES generators side by side, split off from the one passed in,
+// so the inner loops have no dependency between iterations and the compiler can vectorize them.
+// They consume the same amount of the parent's sequence no matter how many values are filled.
+
+#define RNG_LANES 8
+
+typedef struct Rng Rng;
+struct Rng {
+  u64 state;
+  u64 inc;
+};
+
+Rng  rng_seed(u64 seed, u64 stream);
+u32  rng_u32(Rng *rng);
+u32  rng_bounded_u32(Rng *rng, u32 bound);
+f32  rng_f32(Rng *rng);
+f32  rng_range_f32(Rng *rng, f32 min, f32 max);
+
+void rng_fill_f32(Rng *rng, f32 *out, s64 count, f32 min, f32 max);
+void rng_fill_unit_vec2(Rng *rng, f32 *out_xy, s64 count);
+
+#endif
+
+
+#if defined(JLIB_RNG_IMPL) != defined(_UNITY_BUILD_)
+
+#ifdef _UNITY_BUILD_
+#define JLIB_RNG_IMPL
+#endif
+
+#define RNG_MULTIPLIER 6364136223846793005ull
+
+force_inline u32 rng_output_(u64 state) {
+  u32 xorshifted = (u32)(((state >> 18) ^ state) >> 27);
+  u32 rot = (u32)(state >> 59);
+  return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+/* 24 bits of mantissa, [0, 1) */
+force_inline f32 rng_unorm_(u32 x) {
+  return (f32)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+Rng rng_seed(u64 seed, u64 stream) {
+  Rng rng = { .state = 0, .inc = (stream << 1) | 1 };
+  rng_u32(&rng);
+  rng.state += seed;
+  rng_u32(&rng);
+  return rng;
+}
+
+force_inline u32 rng_u32(Rng *rng) {
+  u64 old = rng->state;
+  rng->state = old * RNG_MULTIPLIER + rng->inc;
+  return rng_output_(old);
+}
+
+/* Lemire's multiply and reject, no modulo bias */
+u32 rng_bounded_u32(Rng *rng, u32 bound) {
+  u64 m = (u64)rng_u32(rng) * (u64)bound;
+  u32 low = (u32)m;
+
+  if(low < bound) {
+    u32 threshold = -bound % bound;
+    while(low < threshold) {
+      m = (u64)rng_u32(rng) * (u64)bound;
+      low = (u32)m;
+    }
+  }
+
+  return (u32)(m >> 32);
+}
+
+force_inline f32 rng_f32(Rng *rng) {
+  return rng_unorm_(rng_u32(rng));
+}
+
+force_inline f32 rng_range_f32(Rng *rng, f32 min, f32 max) {
+  return min + (max - min) * rng_f32(rng);
+}
+
+typedef struct Rng_lanes_ Rng_lanes_;
+struct Rng_lanes_ {
+  u64 state[RNG_LANES];
+  u64 inc[RNG_LANES];
+};
+
+internal Rng_lanes_ rng_split_lanes_(Rng *rng) {
+  Rng_lanes_ lanes;
+
+  for(int l = 0; l < RNG_LANES; l++) {
+    /* two statements, the order of two calls in one expression is up to the compiler */
+    u64 hi = rng_u32(rng);
+    u64 lo = rng_u32(rng);
+    u64 seed = (hi << 32) | lo;
+    Rng lane = rng_seed(seed, (u64)l);
+    lanes.state[l] = lane.state;
+    lanes.inc[l] = lane.inc;
+  }
+
+  return lanes;
+}
+
+force_inline void rng_lanes_next_(Rng_lanes_ *lanes, u32 out[RNG_LANES]) {
+  for(int l = 0; l < RNG_LANES; l++) {
+    u64 old = lanes->state[l];
+    lanes->state[l] = old * RNG_MULTIPLIER + lanes->inc[l];
+    out[l] = rng_output_(old);
+  }
+}
+
+void rng_fill_f32(Rng *rng, f32 *out, s64 count, f32 min, f32 max) {
+  Rng_lanes_ lanes = rng_split_lanes_(rng);
+
+  f32 scale = max - min;
+
+  for(s64 i = 0; i < count; i += RNG_LANES) {
+    u32 bits[RNG_LANES];
+    rng_lanes_next_(&lanes, bits);
+
+    s64 n = MIN(RNG_LANES, count - i);
+    for(s64 l = 0; l < n; l++) {
+      out[i + l] = min + scale * rng_unorm_(bits[l]);
+    }
+  }
+}
+
+/* interleaved x, y pairs, uniformly distributed on the unit circle */
+void rng_fill_unit_vec2(Rng *rng, f32 *out_xy, s64 count) {
+  Rng_lanes_ lanes = rng_split_lanes_(rng);
+
+  for(s64 i = 0; i < count; i += RNG_LANES) {
+    u32 bits[RNG_LANES];
+    rng_lanes_next_(&lanes, bits);
+
+    s64 n = MIN(RNG_LANES, count - i);
+    for(s64 l = 0; l < n; l++) {
+      f32 angle = rng_unorm_(bits[l]) * (2.0f * 3.14159265358979323846f);
+      out_xy[2*(i + l) + 0] = cosf(angle);
+      out_xy[2*(i + l) + 1] = sinf(angle);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,384 @@
+#ifndef SHADER_MANAGER_H
+#define SHADER_MANAGER_H
+
+
+#include "basic.h"
+#include "str.h"
+#include "asset_stream.h"
+
+
+/* NOTE
+ *
+ * Owns the game's shader programs.
+ *
+ * Sources come in through the asset stream, so they're read off the render thread and hot reload whenever the
+ * cradle sees a .glsl file change. A program is only rebuilt when one of its sources actually changed, and the
+ * new program replaces the old one only after it links. If it doesn't link, the old one stays in use.
+ *
+ * Linked programs are cached on disk with glGetProgramBinary(). The key is the hash of both sources plus the
+ * GL vendor, renderer and version strings, so a driver update just misses the cache. On a hit the driver
+ * compile is skipped and we go straight to glProgramBinary().
+ *
+ * Callers hold on to the program index. shader_manager_generation() changes every time the program is
+ * swapped, so uniform locations can be looked up again.
+ *
+ * Variants are the same pair of sources compiled with a block of #defines inserted after the #version line.
+ * shader_manager_variant() finds or creates one, it gets built on the next update and cached like any other
+ * program, so every combination only pays for the driver compile once per driver. Variants are never evicted,
+ * callers keep drawing with one while the next builds, so the table has to fit every combination a caller can
+ * reach, the game checks that with a STATIC_ASSERT.
+ *
+ */
+
+#define SHADER_MANAGER_MAX_PROGRAMS 128
+#define SHADER_DEFINES_MAX 256
+#define SHADER_CACHE_MAGIC ((u32)0x4253534c) /* "LSSB" */
+
+typedef struct Shader_program Shader_program;
+struct Shader_program {
+  Asset_handle vert;
+  Asset_handle pixel;
+  u32 vert_version;
+  u32 pixel_version;
+
+  s32 base; /* the program this is a variant of, or its own index, only the base owns the sources */
+  char defines[SHADER_DEFINES_MAX];
+
+  Shader shader;
+  u32 generation;
+};
+
+typedef struct Shader_manager Shader_manager;
+struct Shader_manager {
+  Asset_stream *assets;
+
+  Shader_program programs[SHADER_MANAGER_MAX_PROGRAMS];
+  s32 programs_count;
+  b32 full_warned;
+
+  b32 binary_cache;
+  u64 driver_hash;
+  char cache_dir[256];
+};
+
+typedef struct Shader_cache_header Shader_cache_header;
+struct Shader_cache_header {
+  u32 magic;
+  u32 binary_format;
+  u64 key;
+};
+
+
+void   shader_manager_init(Shader_manager *manager, Asset_stream *assets, char *cache_dir);
+void   shader_manager_close(Shader_manager *manager);
+s32    shader_manager_add(Shader_manager *manager, Str8 vert_path, Str8 pixel_path);
+s32    shader_manager_variant(Shader_manager *manager, s32 program, Str8 defines);
+void   shader_manager_update(Shader_manager *manager);
+Shader shader_manager_get(Shader_manager *manager, s32 program);
+u32    shader_manager_generation(Shader_manager *manager, s32 program);
+
+
+#ifdef _UNITY_BUILD_
+#define SHADER_MANAGER_IMPL
+#endif
+
+#ifdef SHADER_MANAGER_IMPL
+
+
+/* same as LoadShaderFromMemory(), which we can't use for programs that come out of the cache */
+internal Shader shader_from_program(u32 program) {
+  Shader result = { .id = program };
+
+  result.locs = RL_CALLOC(RL_MAX_SHADER_LOCATIONS, sizeof(int));
+
+  for(int i = 0; i < RL_MAX_SHADER_LOCATIONS; i++) {
+    result.locs[i] = -1;
+  }
+
+  result.locs[SHADER_LOC_VERTEX_POSITION]    = rlGetLocationAttrib(program, "vertexPosition");
+  result.locs[SHADER_LOC_VERTEX_TEXCOORD01]  = rlGetLocationAttrib(program, "vertexTexCoord");
+  result.locs[SHADER_LOC_VERTEX_TEXCOORD02]  = rlGetLocationAttrib(program, "vertexTexCoord2");
+  result.locs[SHADER_LOC_VERTEX_NORMAL]      = rlGetLocationAttrib(program, "vertexNormal");
+  result.locs[SHADER_LOC_VERTEX_TANGENT]     = rlGetLocationAttrib(program, "vertexTangent");
+  result.locs[SHADER_LOC_VERTEX_COLOR]       = rlGetLocationAttrib(program, "vertexColor");
+  result.locs[SHADER_LOC_MATRIX_MVP]         = rlGetLocationUniform(program, "mvp");
+  result.locs[SHADER_LOC_MATRIX_VIEW]        = rlGetLocationUniform(program, "matView");
+  result.locs[SHADER_LOC_MATRIX_PROJECTION]  = rlGetLocationUniform(program, "matProjection");
+  result.locs[SHADER_LOC_MATRIX_MODEL]       = rlGetLocationUniform(program, "matModel");
+  result.locs[SHADER_LOC_MATRIX_NORMAL]      = rlGetLocationUniform(program, "matNormal");
+  result.locs[SHADER_LOC_COLOR_DIFFUSE]      = rlGetLocationUniform(program, "colDiffuse");
+  result.locs[SHADER_LOC_MAP_DIFFUSE]        = rlGetLocationUniform(program, "texture0");
+  result.locs[SHADER_LOC_MAP_SPECULAR]       = rlGetLocationUniform(program, "texture1");
+  result.locs[SHADER_LOC_MAP_NORMAL]         = rlGetLocationUniform(program, "texture2");
+
+  return result;
+}
+
+internal u64 shader_cache_key(Shader_manager *manager, char *vert_src, char *pixel_src, char *defines) {
+  u64 result = manager->driver_hash;
+
+  u64 hashes[] = { str8_hash(str8_cstr(vert_src)), str8_hash(str8_cstr(pixel_src)), str8_hash(str8_cstr(defines)) };
+
+  for(int i = 0; i < ARRLEN(hashes); i++) {
+    result ^= hashes[i] + 0x9e3779b97f4a7c15ull + (result << 6) + (result >> 2);
+  }
+
+  return result;
+}
+
+/* the defines have to come after #version, which has to be the first line */
+internal char* shader_source_with_defines(char *src, char *defines) {
+  if(!defines[0]) {
+    return src;
+  }
+
+  char *first_line_end = strchr(src, '\n');
+  int first_line_len = first_line_end ? (int)(first_line_end - src) + 1 : 0;
+
+  return scratch_push_cstrf("%.*s%s\n#line 2\n%s", first_line_len, src, defines, src + first_line_len);
+}
+
+internal char* shader_cache_path(Shader_manager *manager, u64 key) {
+  return scratch_push_cstrf("%s/%016lx.bin", manager->cache_dir, key);
+}
+
+internal u32 shader_cache_load(Shader_manager *manager, u64 key) {
+  u32 result = 0;
+
+  char *path = shader_cache_path(manager, key);
+
+  if(!FileExists(path)) {
+    return result;
+  }
+
+  int size = 0;
+  u8 *data = LoadFileData(path, &size);
+
+  if(data && size > (int)sizeof(Shader_cache_header)) {
+    Shader_cache_header header;
+    memory_copy(&header, data, sizeof(header));
+
+    if(header.magic == SHADER_CACHE_MAGIC && header.key == key) {
+      u32 program = glCreateProgram();
+      glProgramBinary(program, header.binary_format, data + sizeof(header), size - (int)sizeof(header));
+
+      GLint linked = 0;
+      glGetProgramiv(program, GL_LINK_STATUS, &linked);
+
+      if(linked) {
+        result = program;
+      } else {
+        /* drivers are allowed to reject their own binaries, just build from source */
+        glDeleteProgram(program);
+      }
+    }
+  }
+
+  UnloadFileData(data);
+
+  return result;
+}
+
+internal void shader_cache_save(Shader_manager *manager, u64 key, u32 program) {
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+  if(length <= 0) {
+    return;
+  }
+
+  scratch_scope() {
+    u8 *data = scratch_push_array_no_zero(u8, sizeof(Shader_cache_header) + length);
+
+    Shader_cache_header header = { .magic = SHADER_CACHE_MAGIC, .key = key };
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &header.binary_format, data + sizeof(header));
+    memory_copy(data, &header, sizeof(header));
+
+    if(written > 0) {
+      SaveFileData(shader_cache_path(manager, key), data, (int)sizeof(header) + written);
+    }
+  }
+}
+
+void shader_manager_init(Shader_manager *manager, Asset_stream *assets, char *cache_dir) {
+  memory_zero(manager, sizeof(*manager));
+
+  manager->assets = assets;
+  snprintf(manager->cache_dir, sizeof(manager->cache_dir), "%s", cache_dir);
+
+  /* program binaries are core since 4.1, before that we need the extension */
+  manager->binary_cache = (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary) && glGetProgramBinary && glProgramBinary;
+
+  if(manager->binary_cache) {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    manager->binary_cache = formats > 0;
+  }
+
+  if(manager->binary_cache && !DirectoryExists(manager->cache_dir) && MakeDirectory(manager->cache_dir) != 0) {
+    manager->binary_cache = 0;
+  }
+
+  if(manager->binary_cache) {
+    scratch_scope() {
+      Str8 driver = scratch_push_str8f("%s|%s|%s", glGetString(GL_VENDOR), glGetString(GL_RENDERER), glGetString(GL_VERSION));
+      manager->driver_hash = str8_hash(driver);
+    }
+  } else {
+    TraceLog(LOG_INFO, "program binaries not supported, shaders will always be built from source");
+  }
+}
+
+void shader_manager_close(Shader_manager *manager) {
+  for(s32 i = 0; i < manager->programs_count; i++) {
+    Shader_program *p = &manager->programs[i];
+
+    if(p->shader.id) {
+      UnloadShader(p->shader);
+    }
+
+    if(p->base == i) {
+      asset_stream_release(manager->assets, p->vert);
+      asset_stream_release(manager->assets, p->pixel);
+    }
+  }
+
+  memory_zero(manager, sizeof(*manager));
+}
+
+s32 shader_manager_add(Shader_manager *manager, Str8 vert_path, Str8 pixel_path) {
+  ASSERT(manager->programs_count < SHADER_MANAGER_MAX_PROGRAMS);
+
+  s32 result = manager->programs_count++;
+
+  manager->programs[result] = (Shader_program) {
+    .vert  = asset_stream_request(manager->assets, ASSET_KIND_TEXT, vert_path),
+    .pixel = asset_stream_request(manager->assets, ASSET_KIND_TEXT, pixel_path),
+    .base  = result,
+  };
+
+  return result;
+}
+
+s32 shader_manager_variant(Shader_manager *manager, s32 program, Str8 defines) {
+  ASSERT(program >= 0 && program < manager->programs_count);
+
+  s32 base = manager->programs[program].base;
+
+  for(s32 i = 0; i < manager->programs_count; i++) {
+    Shader_program *p = &manager->programs[i];
+
+    if(p->base == base && str8_match(str8_cstr(p->defines), defines)) {
+      return i;
+    }
+  }
+
+  if(defines.len >= SHADER_DEFINES_MAX) {
+    TraceLog(LOG_WARNING, "shader variant defines are too long, falling back to the base program");
+    return base;
+  }
+
+  /* asked for every frame, so only say it once */
+  if(manager->programs_count >= SHADER_MANAGER_MAX_PROGRAMS) {
+    if(!manager->full_warned) {
+      TraceLog(LOG_WARNING, "all %i shader programs are in use, falling back to the base program, raise SHADER_MANAGER_MAX_PROGRAMS",
+          SHADER_MANAGER_MAX_PROGRAMS);
+      manager->full_warned = 1;
+    }
+
+    return base;
+  }
+
+  s32 result = manager->programs_count++;
+
+  Shader_program *p = &manager->programs[result];
+  *p = (Shader_program) {
+    .vert  = manager->programs[base].vert,
+    .pixel = manager->programs[base].pixel,
+    .base  = base,
+  };
+  memory_copy(p->defines, defines.s, defines.len);
+
+  return result;
+}
+
+internal void shader_program_build(Shader_manager *manager, s32 i) {
+  Shader_program *p = &manager->programs[i];
+
+  char *vert_src = asset_stream_get_text(manager->assets, p->vert);
+  char *pixel_src = asset_stream_get_text(manager->assets, p->pixel);
+
+  u64 key = 0;
+  u32 program = 0;
+  b32 from_cache = 0;
+
+  if(manager->binary_cache) {
+    key = shader_cache_key(manager, vert_src, pixel_src, p->defines);
+    program = shader_cache_load(manager, key);
+    from_cache = program != 0;
+  }
+
+  if(!program) {
+    program = rlLoadShaderCode(shader_source_with_defines(vert_src, p->defines), shader_source_with_defines(pixel_src, p->defines));
+
+    /* rlgl hands back its default shader when compiling or linking fails */
+    if(program == rlGetShaderIdDefault()) {
+      TraceLog(LOG_WARNING, "shader program %i failed to build, keeping the old one", i);
+      return;
+    }
+
+    if(manager->binary_cache) {
+      shader_cache_save(manager, key, program);
+    }
+  }
+
+  if(p->shader.id) {
+    UnloadShader(p->shader);
+  }
+
+  p->shader = shader_from_program(program);
+  p->generation++;
+
+  TraceLog(LOG_INFO, "shader program %i %s", i, from_cache ? "loaded from the binary cache" : "built from source");
+}
+
+void shader_manager_update(Shader_manager *manager) {
+  for(s32 i = 0; i < manager->programs_count; i++) {
+    Shader_program *p = &manager->programs[i];
+
+    u32 vert_version = asset_stream_version(manager->assets, p->vert);
+    u32 pixel_version = asset_stream_version(manager->assets, p->pixel);
+
+    if(!vert_version || !pixel_version) {
+      continue;
+    }
+
+    if(vert_version == p->vert_version && pixel_version == p->pixel_version) {
+      continue;
+    }
+
+    p->vert_version = vert_version;
+    p->pixel_version = pixel_version;
+
+    scratch_scope() {
+      shader_program_build(manager, i);
+    }
+  }
+}
+
+/* id is 0 until the first successful build */
+Shader shader_manager_get(Shader_manager *manager, s32 program) {
+  ASSERT(program >= 0 && program < manager->programs_count);
+  return manager->programs[program].shader;
+}
+
+u32 shader_manager_generation(Shader_manager *manager, s32 program) {
+  ASSERT(program >= 0 && program < manager->programs_count);
+  return manager->programs[program].generation;
+}
+
+
+#endif
+
+#endif
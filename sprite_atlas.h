@@ -0,0 +1,389 @@
+#ifndef SPRITE_ATLAS_H
+#define SPRITE_ATLAS_H
+
+
+#include "basic.h"
+#include "arena.h"
+#include "str.h"
+#include "os.h"
+#include "sprite.h"
+
+
+/* NOTE
+ *
+ * Binary sprite atlas, the runtime alternative to the generated sprite_data.c.
+ *
+ * The metaprogram writes it next to the atlas png and the game maps it read only at startup
+ * (and again on every asset reload), so changing art no longer requires a recompile.
+ *
+ * Layout, every section is aligned to SPRITE_ATLAS_ALIGN:
+ *
+ *   Sprite_atlas_header
+ *   Sprite_frame       frames[frames_count]
+ *   Sprite_atlas_entry entries[entries_count]
+ *   u32                hash_slots[hash_slots_count]   entry index + 1, 0 means empty, linear probing
+ *   u8                 names[names_size]              null terminated names, referenced by the entries
+ *   u8                 texture[texture_size]          raw pixels in texture_format
+ *
+ * Names are the same upper case identifiers the C path generates minus the SPRITE_ / SPRITE_KEYFRAME_ prefix,
+ * so SPRITE_PLAYER_IDLE is looked up as "PLAYER_IDLE".
+ *
+ * The file is written and read by the same machine, so everything is in host byte order and the structs are
+ * stored as is. Bump SPRITE_ATLAS_VERSION whenever one of them changes.
+ *
+ */
+
+#define SPRITE_ATLAS_MAGIC   ((u32)0x534c4c4c) /* "LLLS" */
+#define SPRITE_ATLAS_VERSION ((u32)1)
+#define SPRITE_ATLAS_ALIGN   16
+#define SPRITE_ATLAS_TEXTURE_MAX 16384 /* per side, keeps GetPixelDataSize() well inside an int */
+
+#define SPRITE_ATLAS_ENTRY_KINDS      \
+  X(SPRITE)                           \
+  X(KEYFRAME)                         \
+
+typedef enum Sprite_atlas_entry_kind {
+  SPRITE_ATLAS_ENTRY_KIND_INVALID = -1,
+#define X(kind) SPRITE_ATLAS_ENTRY_KIND_##kind,
+  SPRITE_ATLAS_ENTRY_KINDS
+#undef X
+    SPRITE_ATLAS_ENTRY_KIND_MAX,
+} Sprite_atlas_entry_kind;
+
+typedef struct Sprite_atlas_header Sprite_atlas_header;
+struct Sprite_atlas_header {
+  u32 magic;
+  u32 version;
+
+  u32 frames_count;
+  u32 entries_count;
+  u32 hash_slots_count; /* power of 2 */
+
+  s32 texture_width;
+  s32 texture_height;
+  s32 texture_format;   /* raylib PixelFormat */
+
+  u64 frames_offset;
+  u64 entries_offset;
+  u64 hash_slots_offset;
+  u64 names_offset;
+  u64 names_size;
+  u64 texture_offset;
+  u64 texture_size;
+
+  u64 file_size;
+};
+
+typedef struct Sprite_atlas_entry Sprite_atlas_entry;
+struct Sprite_atlas_entry {
+  u64 name_hash;
+  u32 name_offset;
+  u32 name_len;
+  s32 kind;
+  s32 keyframe;
+  Sprite sprite;
+};
+
+typedef struct Sprite_atlas Sprite_atlas;
+struct Sprite_atlas {
+  u8 *base;
+  u64 size;
+
+  Sprite_atlas_header *header;
+  Sprite_frame        *frames;
+  Sprite_atlas_entry  *entries;
+  u32                 *hash_slots;
+  u8                  *names;
+  u8                  *texture;
+};
+
+/* what the metaprogram hands to sprite_atlas_serialize() for every sprite and keyframe */
+typedef struct Sprite_atlas_build_entry Sprite_atlas_build_entry;
+struct Sprite_atlas_build_entry {
+  Str8 name;
+  Sprite_atlas_entry_kind kind;
+  s32 keyframe;
+  Sprite sprite;
+};
+
+
+b32  sprite_atlas_from_memory(Sprite_atlas *atlas, u8 *data, u64 size);
+b32  sprite_atlas_load(Sprite_atlas *atlas, Str8 path);
+void sprite_atlas_unload(Sprite_atlas *atlas);
+
+Sprite_atlas_entry* sprite_atlas_find(Sprite_atlas *atlas, Str8 name, Sprite_atlas_entry_kind kind);
+b32 sprite_atlas_get_sprite(Sprite_atlas *atlas, Str8 name, Sprite *sprite);
+b32 sprite_atlas_get_keyframe(Sprite_atlas *atlas, Str8 name, s32 *keyframe);
+Image sprite_atlas_image(Sprite_atlas *atlas);
+
+Str8 sprite_atlas_serialize(Arena *a, Sprite_frame_slice frames, Sprite_atlas_build_entry *entries, s64 entries_count, Image image);
+
+
+#ifdef _UNITY_BUILD_
+#define SPRITE_ATLAS_IMPL
+#endif
+
+#ifdef SPRITE_ATLAS_IMPL
+
+
+internal b32 sprite_atlas_section_fits(u64 offset, u64 len, u64 size) {
+  return offset % SPRITE_ATLAS_ALIGN == 0 && offset <= size && len <= size - offset;
+}
+
+b32 sprite_atlas_from_memory(Sprite_atlas *atlas, u8 *data, u64 size) {
+  memory_zero(atlas, sizeof(*atlas));
+
+  if(!data || size < sizeof(Sprite_atlas_header)) {
+    return 0;
+  }
+
+  Sprite_atlas_header *header = (Sprite_atlas_header*)data;
+
+  if(header->magic != SPRITE_ATLAS_MAGIC) {
+    TraceLog(LOG_ERROR, "sprite atlas has a bad magic number 0x%08x", header->magic);
+    return 0;
+  }
+
+  if(header->version != SPRITE_ATLAS_VERSION) {
+    TraceLog(LOG_ERROR, "sprite atlas has version %u, expected %u, rerun the metaprogram", header->version, SPRITE_ATLAS_VERSION);
+    return 0;
+  }
+
+  /* NOTE
+   * The file comes off disk and might be stale or half written, so nothing in it is trusted. Sections are
+   * checked as offset <= size && len <= size - offset, so a huge offset can't wrap around, and every index the
+   * lookups and the texture upload index with later is checked here once, so they don't have to.
+   */
+  b32 valid =
+    header->file_size == size &&
+    sprite_atlas_section_fits(header->frames_offset, sizeof(Sprite_frame)*(u64)header->frames_count, size) &&
+    sprite_atlas_section_fits(header->entries_offset, sizeof(Sprite_atlas_entry)*(u64)header->entries_count, size) &&
+    sprite_atlas_section_fits(header->hash_slots_offset, sizeof(u32)*(u64)header->hash_slots_count, size) &&
+    sprite_atlas_section_fits(header->names_offset, header->names_size, size) &&
+    sprite_atlas_section_fits(header->texture_offset, header->texture_size, size) &&
+    header->hash_slots_count && IS_POW_2(header->hash_slots_count);
+
+  /* only uncompressed formats, the upload goes a row at a time */
+  if(valid) {
+    valid =
+      header->texture_width > 0 && header->texture_width <= SPRITE_ATLAS_TEXTURE_MAX &&
+      header->texture_height > 0 && header->texture_height <= SPRITE_ATLAS_TEXTURE_MAX &&
+      header->texture_format >= PIXELFORMAT_UNCOMPRESSED_GRAYSCALE && header->texture_format < PIXELFORMAT_COMPRESSED_DXT1_RGB &&
+      header->texture_size == (u64)GetPixelDataSize(header->texture_width, header->texture_height, header->texture_format);
+  }
+
+  if(valid) {
+    u32 *hash_slots = (u32*)(data + header->hash_slots_offset);
+
+    for(u32 i = 0; valid && i < header->hash_slots_count; i++) {
+      valid = hash_slots[i] <= header->entries_count;
+    }
+  }
+
+  if(valid) {
+    Sprite_atlas_entry *entries = (Sprite_atlas_entry*)(data + header->entries_offset);
+    s64 frames_count = (s64)header->frames_count;
+
+    for(u32 i = 0; valid && i < header->entries_count; i++) {
+      Sprite_atlas_entry *entry = &entries[i];
+
+      valid = (u64)entry->name_offset + (u64)entry->name_len <= header->names_size;
+
+      if(entry->kind == SPRITE_ATLAS_ENTRY_KIND_SPRITE) {
+        valid = valid &&
+          entry->sprite.first_frame >= 0 && entry->sprite.first_frame < frames_count &&
+          entry->sprite.last_frame >= entry->sprite.first_frame && entry->sprite.last_frame < frames_count &&
+          entry->sprite.total_frames <= entry->sprite.last_frame - entry->sprite.first_frame + 1;
+      } else if(entry->kind == SPRITE_ATLAS_ENTRY_KIND_KEYFRAME) {
+        valid = valid && entry->keyframe >= 0 && entry->keyframe < frames_count;
+      } else {
+        valid = 0;
+      }
+    }
+  }
+
+  if(!valid) {
+    TraceLog(LOG_ERROR, "sprite atlas is truncated or corrupt");
+    return 0;
+  }
+
+  atlas->base       = data;
+  atlas->size       = size;
+  atlas->header     = header;
+  atlas->frames     = (Sprite_frame*)(data + header->frames_offset);
+  atlas->entries    = (Sprite_atlas_entry*)(data + header->entries_offset);
+  atlas->hash_slots = (u32*)(data + header->hash_slots_offset);
+  atlas->names      = data + header->names_offset;
+  atlas->texture    = data + header->texture_offset;
+
+  return 1;
+}
+
+b32 sprite_atlas_load(Sprite_atlas *atlas, Str8 path) {
+  u64 size = 0;
+  u8 *data = os_map_file(path, &size);
+
+  if(!data) {
+    memory_zero(atlas, sizeof(*atlas));
+    return 0;
+  }
+
+  if(!sprite_atlas_from_memory(atlas, data, size)) {
+    os_unmap_file(data, size);
+    return 0;
+  }
+
+  return 1;
+}
+
+void sprite_atlas_unload(Sprite_atlas *atlas) {
+  os_unmap_file(atlas->base, atlas->size);
+  memory_zero(atlas, sizeof(*atlas));
+}
+
+Sprite_atlas_entry* sprite_atlas_find(Sprite_atlas *atlas, Str8 name, Sprite_atlas_entry_kind kind) {
+  Sprite_atlas_entry *result = 0;
+
+  if(!atlas->header) {
+    return result;
+  }
+
+  u64 hash = str8_hash(name);
+  u32 mask = atlas->header->hash_slots_count - 1;
+
+  for(u32 slot = (u32)hash & mask, probes = 0; probes <= mask; slot = (slot + 1) & mask, probes++) {
+    u32 entry_index = atlas->hash_slots[slot];
+
+    if(entry_index == 0) {
+      break;
+    }
+
+    Sprite_atlas_entry *entry = &atlas->entries[entry_index - 1];
+    Str8 entry_name = { .s = atlas->names + entry->name_offset, .len = entry->name_len };
+
+    if(entry->name_hash == hash && entry->kind == kind && str8_match(entry_name, name)) {
+      result = entry;
+      break;
+    }
+  }
+
+  return result;
+}
+
+b32 sprite_atlas_get_sprite(Sprite_atlas *atlas, Str8 name, Sprite *sprite) {
+  Sprite_atlas_entry *entry = sprite_atlas_find(atlas, name, SPRITE_ATLAS_ENTRY_KIND_SPRITE);
+
+  if(entry) {
+    *sprite = entry->sprite;
+  }
+
+  return entry != 0;
+}
+
+b32 sprite_atlas_get_keyframe(Sprite_atlas *atlas, Str8 name, s32 *keyframe) {
+  Sprite_atlas_entry *entry = sprite_atlas_find(atlas, name, SPRITE_ATLAS_ENTRY_KIND_KEYFRAME);
+
+  if(entry) {
+    *keyframe = entry->keyframe;
+  }
+
+  return entry != 0;
+}
+
+/* NOTE the image points into the mapping, don't UnloadImage() it */
+Image sprite_atlas_image(Sprite_atlas *atlas) {
+  Image result = {0};
+
+  if(atlas->header) {
+    result = (Image) {
+      .data    = atlas->texture,
+      .width   = atlas->header->texture_width,
+      .height  = atlas->header->texture_height,
+      .mipmaps = 1,
+      .format  = atlas->header->texture_format,
+    };
+  }
+
+  return result;
+}
+
+Str8 sprite_atlas_serialize(Arena *a, Sprite_frame_slice frames, Sprite_atlas_build_entry *entries, s64 entries_count, Image image) {
+  Sprite_atlas_header header = {
+    .magic          = SPRITE_ATLAS_MAGIC,
+    .version        = SPRITE_ATLAS_VERSION,
+    .frames_count   = (u32)frames.count,
+    .entries_count  = (u32)entries_count,
+    .texture_width  = image.width,
+    .texture_height = image.height,
+    .texture_format = image.format,
+  };
+
+  /* keep the load factor at or below 0.5 */
+  header.hash_slots_count = 1;
+  while(header.hash_slots_count < 2*entries_count) {
+    header.hash_slots_count <<= 1;
+  }
+
+  u64 names_size = 0;
+  for(s64 i = 0; i < entries_count; i++) {
+    names_size += entries[i].name.len + 1;
+  }
+
+  u64 pos = ALIGN_UP(sizeof(Sprite_atlas_header), SPRITE_ATLAS_ALIGN);
+  header.frames_offset = pos;
+  pos = ALIGN_UP(pos + sizeof(Sprite_frame)*header.frames_count, SPRITE_ATLAS_ALIGN);
+  header.entries_offset = pos;
+  pos = ALIGN_UP(pos + sizeof(Sprite_atlas_entry)*header.entries_count, SPRITE_ATLAS_ALIGN);
+  header.hash_slots_offset = pos;
+  pos = ALIGN_UP(pos + sizeof(u32)*header.hash_slots_count, SPRITE_ATLAS_ALIGN);
+  header.names_offset = pos;
+  header.names_size = names_size;
+  pos = ALIGN_UP(pos + names_size, SPRITE_ATLAS_ALIGN);
+  header.texture_offset = pos;
+  header.texture_size = (u64)GetPixelDataSize(image.width, image.height, image.format);
+  pos += header.texture_size;
+  header.file_size = pos;
+
+  u8 *data = push_array_aligned(a, u8, header.file_size, SPRITE_ATLAS_ALIGN);
+
+  memory_copy(data, &header, sizeof(header));
+  memory_copy(data + header.frames_offset, frames.d, sizeof(Sprite_frame)*frames.count);
+
+  Sprite_atlas_entry *out_entries = (Sprite_atlas_entry*)(data + header.entries_offset);
+  u32 *hash_slots = (u32*)(data + header.hash_slots_offset);
+  u8 *names = data + header.names_offset;
+  u32 mask = header.hash_slots_count - 1;
+
+  u64 name_offset = 0;
+  for(s64 i = 0; i < entries_count; i++) {
+    Sprite_atlas_build_entry e = entries[i];
+
+    Sprite_atlas_entry *entry = &out_entries[i];
+    entry->name_hash   = str8_hash(e.name);
+    entry->name_offset = (u32)name_offset;
+    entry->name_len    = (u32)e.name.len;
+    entry->kind        = e.kind;
+    entry->keyframe    = e.keyframe;
+    entry->sprite      = e.sprite;
+
+    memory_copy(names + name_offset, e.name.s, e.name.len);
+    name_offset += e.name.len + 1;
+
+    u32 slot = (u32)entry->name_hash & mask;
+    while(hash_slots[slot]) {
+      slot = (slot + 1) & mask;
+    }
+    hash_slots[slot] = (u32)i + 1;
+  }
+
+  memory_copy(data + header.texture_offset, image.data, header.texture_size);
+
+  Str8 result = { .s = data, .len = (s64)header.file_size };
+
+  return result;
+}
+
+
+#endif
+
+#endif
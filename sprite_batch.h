@@ -0,0 +1,360 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+
+#include "basic.h"
+#include "arena.h"
+#include "sprite.h"
+
+
+/* NOTE
+ *
+ * Animates and draws a whole bunch of sprites that share one atlas texture.
+ *
+ * The Sprite state is kept as a struct of arrays so sprite_batch_update() can advance every animation
+ * and write the per instance data in a single pass, and sprite_batch_draw() then issues one instanced
+ * draw call for the whole batch. The atlas rects live in a float texture indexed by the absolute frame
+ * index, so an instance is just a transform, a frame index, mirror bits and a tint.
+ *
+ * Use one batch per atlas texture.
+ *
+ */
+
+#define SPRITE_BATCH_FRAMES_TEX_WIDTH 1024
+
+/* vertex attribute locations, must match sprite_vert.glsl */
+#define SPRITE_BATCH_ATTRIB_CORNER          0
+#define SPRITE_BATCH_ATTRIB_POSITION_SCALE  1
+#define SPRITE_BATCH_ATTRIB_ROTATION_FRAME  2
+#define SPRITE_BATCH_ATTRIB_TINT            3
+
+typedef struct Sprite_instance Sprite_instance;
+struct Sprite_instance {
+  Vector2 position;
+  Vector2 scale;
+  f32     rotation; /* radians */
+  f32     frame;    /* absolute frame index, floats are exact well past any atlas we'll have */
+  f32     mirror;   /* bit 0 mirrors x, bit 1 mirrors y */
+  Color   tint;
+};
+
+STATIC_ASSERT(sizeof(Sprite_instance) == 32, sprite_instance_is_32_bytes);
+
+typedef struct Sprite_batch Sprite_batch;
+struct Sprite_batch {
+  s32 count;
+  s32 cap;
+
+  u32 revision; /* bumped whenever sprite_batch_draw() would draw something different */
+
+  /* Sprite, split up */
+  Sprite_flags *flags;
+  s32          *first_frame;
+  s32          *last_frame;
+  s32          *fps;
+  s32          *total_frames;
+  s32          *cur_frame;     /* for pingpong this walks the whole back and forth cycle */
+  s32          *frame_counter; /* microseconds spent on the current frame */
+  s32          *repeats;
+
+  Vector2 *position;
+  Vector2 *scale;
+  f32     *rotation;
+  Color   *tint;
+
+  Sprite_instance *instances;
+
+  Texture2D atlas_tex;
+  Texture2D frames_tex;
+  s64       frames_count;
+
+  u32 vao;
+  u32 quad_vbo;
+  u32 instances_vbo;
+};
+
+
+void sprite_batch_init(Sprite_batch *batch, Arena *arena, s32 cap);
+void sprite_batch_close(Sprite_batch *batch);
+void sprite_batch_set_atlas(Sprite_batch *batch, Texture2D atlas_tex, Sprite_frame *frames, s64 frames_count);
+
+s32  sprite_batch_push(Sprite_batch *batch, Sprite sprite, Vector2 position, Vector2 scale, f32 rotation, Color tint);
+Sprite sprite_batch_get(Sprite_batch *batch, s32 i);
+void sprite_batch_clear(Sprite_batch *batch);
+
+void sprite_batch_update(Sprite_batch *batch, f32 dt);
+void sprite_batch_draw(Sprite_batch *batch, Shader shader);
+
+
+#ifdef _UNITY_BUILD_
+#define SPRITE_BATCH_IMPL
+#endif
+
+#ifdef SPRITE_BATCH_IMPL
+
+
+void sprite_batch_init(Sprite_batch *batch, Arena *arena, s32 cap) {
+  memory_zero(batch, sizeof(*batch));
+
+  batch->cap = cap;
+
+  batch->flags         = push_array(arena, Sprite_flags, cap);
+  batch->first_frame   = push_array(arena, s32, cap);
+  batch->last_frame    = push_array(arena, s32, cap);
+  batch->fps           = push_array(arena, s32, cap);
+  batch->total_frames  = push_array(arena, s32, cap);
+  batch->cur_frame     = push_array(arena, s32, cap);
+  batch->frame_counter = push_array(arena, s32, cap);
+  batch->repeats       = push_array(arena, s32, cap);
+
+  batch->position = push_array(arena, Vector2, cap);
+  batch->scale    = push_array(arena, Vector2, cap);
+  batch->rotation = push_array(arena, f32, cap);
+  batch->tint     = push_array(arena, Color, cap);
+
+  batch->instances = push_array(arena, Sprite_instance, cap);
+
+  /* two triangles, the corner goes from 0 to 1 and the vertex shader does the rest */
+  f32 quad[] = {
+    0, 0,   1, 0,   1, 1,
+    0, 0,   1, 1,   0, 1,
+  };
+
+  batch->vao = rlLoadVertexArray();
+  rlEnableVertexArray(batch->vao);
+
+  batch->quad_vbo = rlLoadVertexBuffer(quad, sizeof(quad), false);
+  rlSetVertexAttribute(SPRITE_BATCH_ATTRIB_CORNER, 2, RL_FLOAT, false, 0, 0);
+  rlEnableVertexAttribute(SPRITE_BATCH_ATTRIB_CORNER);
+
+  batch->instances_vbo = rlLoadVertexBuffer(0, sizeof(Sprite_instance)*cap, true);
+
+  rlSetVertexAttribute(SPRITE_BATCH_ATTRIB_POSITION_SCALE, 4, RL_FLOAT, false, sizeof(Sprite_instance), offsetof(Sprite_instance, position));
+  rlEnableVertexAttribute(SPRITE_BATCH_ATTRIB_POSITION_SCALE);
+  rlSetVertexAttributeDivisor(SPRITE_BATCH_ATTRIB_POSITION_SCALE, 1);
+
+  rlSetVertexAttribute(SPRITE_BATCH_ATTRIB_ROTATION_FRAME, 3, RL_FLOAT, false, sizeof(Sprite_instance), offsetof(Sprite_instance, rotation));
+  rlEnableVertexAttribute(SPRITE_BATCH_ATTRIB_ROTATION_FRAME);
+  rlSetVertexAttributeDivisor(SPRITE_BATCH_ATTRIB_ROTATION_FRAME, 1);
+
+  rlSetVertexAttribute(SPRITE_BATCH_ATTRIB_TINT, 4, RL_UNSIGNED_BYTE, true, sizeof(Sprite_instance), offsetof(Sprite_instance, tint));
+  rlEnableVertexAttribute(SPRITE_BATCH_ATTRIB_TINT);
+  rlSetVertexAttributeDivisor(SPRITE_BATCH_ATTRIB_TINT, 1);
+
+  rlDisableVertexArray();
+  rlDisableVertexBuffer();
+}
+
+void sprite_batch_close(Sprite_batch *batch) {
+  if(batch->frames_tex.id) {
+    rlUnloadTexture(batch->frames_tex.id);
+  }
+
+  rlUnloadVertexBuffer(batch->instances_vbo);
+  rlUnloadVertexBuffer(batch->quad_vbo);
+  rlUnloadVertexArray(batch->vao);
+
+  memory_zero(batch, sizeof(*batch));
+}
+
+/* NOTE the batch doesn't own the atlas texture, call this again whenever the atlas is reloaded */
+void sprite_batch_set_atlas(Sprite_batch *batch, Texture2D atlas_tex, Sprite_frame *frames, s64 frames_count) {
+  if(batch->frames_tex.id) {
+    rlUnloadTexture(batch->frames_tex.id);
+    batch->frames_tex = (Texture2D){0};
+  }
+
+  batch->atlas_tex = atlas_tex;
+  batch->frames_count = frames_count;
+  batch->revision++;
+
+  if(frames_count <= 0) {
+    return;
+  }
+
+  int width = (int)MIN(frames_count, SPRITE_BATCH_FRAMES_TEX_WIDTH);
+  int height = (int)((frames_count + width - 1) / width);
+
+  Vector4 *rects = os_alloc(sizeof(Vector4)*width*height);
+  memory_zero(rects, sizeof(Vector4)*width*height);
+
+  for(s64 i = 0; i < frames_count; i++) {
+    rects[i] = (Vector4){ frames[i].x, frames[i].y, frames[i].w, frames[i].h };
+  }
+
+  batch->frames_tex = (Texture2D) {
+    .id      = rlLoadTexture(rects, width, height, PIXELFORMAT_UNCOMPRESSED_R32G32B32A32, 1),
+    .width   = width,
+    .height  = height,
+    .mipmaps = 1,
+    .format  = PIXELFORMAT_UNCOMPRESSED_R32G32B32A32,
+  };
+
+  os_free(rects);
+}
+
+s32 sprite_batch_push(Sprite_batch *batch, Sprite sprite, Vector2 position, Vector2 scale, f32 rotation, Color tint) {
+  if(batch->count >= batch->cap) {
+    return -1;
+  }
+
+  s32 i = batch->count++;
+
+  batch->flags[i]         = sprite.flags & ~SPRITE_FLAG_AT_LAST_FRAME;
+  batch->first_frame[i]   = sprite.first_frame;
+  batch->last_frame[i]    = sprite.last_frame;
+  batch->fps[i]           = sprite.fps;
+  batch->total_frames[i]  = MAX(sprite.total_frames, 1);
+  batch->cur_frame[i]     = sprite.cur_frame;
+  batch->frame_counter[i] = sprite.frame_counter;
+  batch->repeats[i]       = sprite.repeats;
+
+  batch->position[i] = position;
+  batch->scale[i]    = scale;
+  batch->rotation[i] = rotation;
+  batch->tint[i]     = tint;
+
+  batch->revision++;
+
+  return i;
+}
+
+Sprite sprite_batch_get(Sprite_batch *batch, s32 i) {
+  ASSERT(i >= 0 && i < batch->count);
+
+  Sprite result = {
+    .flags         = batch->flags[i],
+    .first_frame   = batch->first_frame[i],
+    .last_frame    = batch->last_frame[i],
+    .fps           = batch->fps[i],
+    .total_frames  = batch->total_frames[i],
+    .cur_frame     = batch->cur_frame[i],
+    .frame_counter = batch->frame_counter[i],
+    .repeats       = batch->repeats[i],
+  };
+
+  return result;
+}
+
+void sprite_batch_clear(Sprite_batch *batch) {
+  batch->count = 0;
+  batch->revision++;
+}
+
+void sprite_batch_update(Sprite_batch *batch, f32 dt) {
+  s32 dt_us = (s32)(dt * 1e6f);
+  b32 changed = 0;
+
+  for(s32 i = 0; i < batch->count; i++) {
+    Sprite_flags flags = batch->flags[i];
+    s32 total_frames = batch->total_frames[i];
+    s32 cur_frame = batch->cur_frame[i];
+
+    { /* advance */
+
+      b32 animated = !(flags & (SPRITE_FLAG_STILL | SPRITE_FLAG_AT_LAST_FRAME)) && batch->fps[i] > 0 && total_frames > 1;
+
+      if(animated) {
+        s32 frame_us = 1000000 / batch->fps[i];
+        s32 cycle_frames = (flags & SPRITE_FLAG_PINGPONG) ? 2*total_frames - 2 : total_frames;
+        s32 frame_counter = batch->frame_counter[i] + dt_us;
+
+        while(frame_counter >= frame_us) {
+          frame_counter -= frame_us;
+          cur_frame++;
+
+          if(cur_frame >= cycle_frames) {
+            if(flags & SPRITE_FLAG_INFINITE_REPEAT) {
+              cur_frame = 0;
+            } else if(batch->repeats[i] > 1) {
+              batch->repeats[i]--;
+              cur_frame = 0;
+            } else {
+              /* pingpong ends where it started */
+              cur_frame = (flags & SPRITE_FLAG_PINGPONG) ? 0 : total_frames - 1;
+              flags |= SPRITE_FLAG_AT_LAST_FRAME;
+              frame_counter = 0;
+              break;
+            }
+          }
+        }
+
+        batch->frame_counter[i] = frame_counter;
+        batch->cur_frame[i] = cur_frame;
+        batch->flags[i] = flags;
+      }
+
+    } /* advance */
+
+    { /* pack instance */
+
+      s32 frame = cur_frame;
+
+      if(frame >= total_frames) {
+        frame = 2*total_frames - 2 - frame;
+      }
+
+      s32 abs_frame = (flags & SPRITE_FLAG_REVERSE) ? batch->last_frame[i] - frame : batch->first_frame[i] + frame;
+
+      /* only the frame moves here, everything else comes from sprite_batch_push() which bumps the revision */
+      changed |= batch->instances[i].frame != (f32)abs_frame;
+
+      u32 mirror =
+        ((flags & SPRITE_FLAG_DRAW_MIRRORED_X) ? 0x1 : 0) |
+        ((flags & SPRITE_FLAG_DRAW_MIRRORED_Y) ? 0x2 : 0);
+
+      batch->instances[i] = (Sprite_instance) {
+        .position = batch->position[i],
+        .scale    = batch->scale[i],
+        .rotation = batch->rotation[i],
+        .frame    = (f32)abs_frame,
+        .mirror   = (f32)mirror,
+        .tint     = batch->tint[i],
+      };
+
+    } /* pack instance */
+  }
+
+  if(changed) {
+    batch->revision++;
+  }
+}
+
+void sprite_batch_draw(Sprite_batch *batch, Shader shader) {
+  if(batch->count <= 0 || !batch->frames_tex.id || !batch->atlas_tex.id) {
+    return;
+  }
+
+  /* whatever raylib has batched so far has to land before us */
+  rlDrawRenderBatchActive();
+
+  rlUpdateVertexBuffer(batch->instances_vbo, batch->instances, sizeof(Sprite_instance)*batch->count, 0);
+
+  rlEnableShader(shader.id);
+
+  Matrix mvp = MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection());
+  rlSetUniformMatrix(rlGetLocationUniform(shader.id, "mvp"), mvp);
+
+  rlActiveTextureSlot(0);
+  rlEnableTexture(batch->atlas_tex.id);
+  rlSetUniform(rlGetLocationUniform(shader.id, "atlas_tex"), &(int){0}, RL_SHADER_UNIFORM_SAMPLER2D, 1);
+
+  rlActiveTextureSlot(1);
+  rlEnableTexture(batch->frames_tex.id);
+  rlSetUniform(rlGetLocationUniform(shader.id, "frames_tex"), &(int){1}, RL_SHADER_UNIFORM_SAMPLER2D, 1);
+
+  rlEnableVertexArray(batch->vao);
+  rlDrawVertexArrayInstanced(0, 6, batch->count);
+  rlDisableVertexArray();
+
+  rlDisableTexture();
+  rlActiveTextureSlot(0);
+  rlDisableTexture();
+
+  rlDisableShader();
+}
+
+
+#endif
+
+#endif
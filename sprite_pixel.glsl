@@ -0,0 +1,16 @@
+#version 330 core
+
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+out vec4 finalColor;
+
+uniform sampler2D atlas_tex;
+
+void main() {
+  vec4 texel = texture(atlas_tex, fragTexCoord);
+
+  if(texel.a == 0.0) discard;
+
+  finalColor = texel*fragColor;
+}
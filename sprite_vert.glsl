@@ -0,0 +1,40 @@
+#version 330 core
+
+// per vertex, a unit quad corner
+layout(location = 0) in vec2 corner;
+
+// per instance, see Sprite_instance in sprite_batch.h
+layout(location = 1) in vec4 position_scale;
+layout(location = 2) in vec3 rotation_frame_mirror;
+layout(location = 3) in vec4 tint;
+
+out vec2 fragTexCoord;
+out vec4 fragColor;
+
+uniform mat4 mvp;
+uniform sampler2D atlas_tex;
+uniform sampler2D frames_tex;
+
+void main() {
+  int frame = int(rotation_frame_mirror.y);
+  int mirror = int(rotation_frame_mirror.z);
+  int frames_width = textureSize(frames_tex, 0).x;
+
+  // x, y, w, h in atlas pixels
+  vec4 rect = texelFetch(frames_tex, ivec2(frame % frames_width, frame / frames_width), 0);
+
+  vec2 uv_corner = corner;
+  if((mirror & 1) != 0) uv_corner.x = 1.0 - uv_corner.x;
+  if((mirror & 2) != 0) uv_corner.y = 1.0 - uv_corner.y;
+
+  fragTexCoord = (rect.xy + uv_corner*rect.zw) / vec2(textureSize(atlas_tex, 0));
+  fragColor = tint;
+
+  // sprites are centered on their position
+  vec2 local = (corner - 0.5)*rect.zw*position_scale.zw;
+  float c = cos(rotation_frame_mirror.x);
+  float s = sin(rotation_frame_mirror.x);
+  local = vec2(c*local.x - s*local.y, s*local.x + c*local.y);
+
+  gl_Position = mvp*vec4(position_scale.xy + local, 0.0, 1.0);
+}
@@ -4,6 +4,7 @@
 
 #include "basic.h"
 #include "arena.h"
+#include "cpu.h"
 //#include "context.h"
 
 
@@ -28,6 +29,7 @@ struct Str8_list {
 };
 
 #define str8_lit(strlit) ((Str8){ .s = (u8*)(strlit), .len = sizeof(strlit) - 1 })
+#define str8_cstr(cstr) ((Str8){ .s = (u8*)(cstr), .len = (s64)memory_strlen(cstr) })
 
 b32 str8_match(Str8 a_str, Str8 b_str);
 #define str8_match_lit(a_lit, b) str8_match(str8_lit(a_lit), b)
@@ -64,6 +66,8 @@ b32 str8_is_decimal(Str8 str);
 Str8 str8_to_upper(Arena *a, Str8 str);
 Str8 str8_to_lower(Arena *a, Str8 str);
 
+u64 str8_hash(Str8 str);
+
 #define is_upper(c) (!!('A' <= (c) && (c) <= 'Z'))
 #define is_lower(c) (!!('a' <= (c) && (c) <= 'z'))
 #define to_lower(c) (is_upper(c) ? ((c) - 'A' + 'a') : (c))
@@ -132,22 +136,137 @@ b32 str8_contains(Str8 str, Str8 substr) {
   return result;
 }
 
-s64 str8_find(Str8 haystack, Str8 needle) {
-  s64 found = -1;
+/* NOTE
+ * str8_find() goes through str8_find_func_, which picks a kernel for cpu_level() on the first call.
+ * The wide kernels compare the first and the last byte of the needle against a whole register of
+ * candidate positions at once and only memcmp the middle where both match, so a needle that hardly
+ * ever shows up costs a couple of compares per 16, 32 or 64 bytes of haystack.
+ */
+typedef s64 Str8_find_func(Str8 haystack, Str8 needle, s64 from);
+
+/* the needle isn't empty and fits in the haystack */
+internal s64 str8_find_scalar_(Str8 haystack, Str8 needle, s64 from) {
+  for(s64 i = from; i <= haystack.len - needle.len; i++) {
+    if(memory_compare(haystack.s + i, needle.s, needle.len) == 0) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+#if CPU_X64
+
+/* the first and last bytes already match */
+force_inline b32 str8_find_match_(u8 *at, Str8 needle) {
+  return needle.len <= 2 || memory_compare(at + 1, needle.s + 1, needle.len - 2) == 0;
+}
+
+internal s64 str8_find_sse2_(Str8 haystack, Str8 needle, s64 from) {
+  __m128i first = _mm_set1_epi8((char)needle.s[0]);
+  __m128i last = _mm_set1_epi8((char)needle.s[needle.len - 1]);
+
+  s64 i = from;
+
+  for(; i + needle.len - 1 + 16 <= haystack.len; i += 16) {
+    __m128i a = _mm_loadu_si128((__m128i*)(haystack.s + i));
+    __m128i b = _mm_loadu_si128((__m128i*)(haystack.s + i + needle.len - 1));
+    u32 mask = (u32)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+
+    for(; mask; mask &= mask - 1) {
+      s64 at = i + __builtin_ctz(mask);
+
+      if(str8_find_match_(haystack.s + at, needle)) {
+        return at;
+      }
+    }
+  }
+
+  return str8_find_scalar_(haystack, needle, i);
+}
+
+CPU_TARGET_AVX2 internal s64 str8_find_avx2_(Str8 haystack, Str8 needle, s64 from) {
+  __m256i first = _mm256_set1_epi8((char)needle.s[0]);
+  __m256i last = _mm256_set1_epi8((char)needle.s[needle.len - 1]);
+
+  s64 i = from;
+
+  for(; i + needle.len - 1 + 32 <= haystack.len; i += 32) {
+    __m256i a = _mm256_loadu_si256((__m256i*)(haystack.s + i));
+    __m256i b = _mm256_loadu_si256((__m256i*)(haystack.s + i + needle.len - 1));
+    u32 mask = (u32)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+
+    for(; mask; mask &= mask - 1) {
+      s64 at = i + __builtin_ctz(mask);
+
+      if(str8_find_match_(haystack.s + at, needle)) {
+        return at;
+      }
+    }
+  }
+
+  return str8_find_sse2_(haystack, needle, i);
+}
+
+CPU_TARGET_AVX512 internal s64 str8_find_avx512_(Str8 haystack, Str8 needle, s64 from) {
+  __m512i first = _mm512_set1_epi8((char)needle.s[0]);
+  __m512i last = _mm512_set1_epi8((char)needle.s[needle.len - 1]);
+
+  s64 i = from;
+
+  for(; i + needle.len - 1 + 64 <= haystack.len; i += 64) {
+    __m512i a = _mm512_loadu_si512((void*)(haystack.s + i));
+    __m512i b = _mm512_loadu_si512((void*)(haystack.s + i + needle.len - 1));
+    u64 mask = _mm512_cmpeq_epi8_mask(a, first) & _mm512_cmpeq_epi8_mask(b, last);
 
-  for(s64 i = 0; i < haystack.len - needle.len; i++) {
-    for(s64 j = 0; j < needle.len; j++) {
-      if(haystack.s[i+j] != needle.s[j]) {
-        goto end;
+    for(; mask; mask &= mask - 1) {
+      s64 at = i + __builtin_ctzll(mask);
+
+      if(str8_find_match_(haystack.s + at, needle)) {
+        return at;
       }
     }
+  }
+
+  return str8_find_avx2_(haystack, needle, i);
+}
+
+#endif
+
+internal s64 str8_find_resolve_(Str8 haystack, Str8 needle, s64 from);
+
+global Str8_find_func *str8_find_func_ = str8_find_resolve_;
+
+internal s64 str8_find_resolve_(Str8 haystack, Str8 needle, s64 from) {
+  Str8_find_func *func = str8_find_scalar_;
+
+  switch(cpu_level()) {
+#if CPU_X64
+    case CPU_LEVEL_AVX512: func = str8_find_avx512_; break;
+    case CPU_LEVEL_AVX2:   func = str8_find_avx2_;   break;
+    case CPU_LEVEL_SSE2:   func = str8_find_sse2_;   break;
+#endif
+    default: break;
+  }
+
+  atomic_write(&str8_find_func_, func);
+
+  return func(haystack, needle, from);
+}
+
+/* index of the first occurrence, -1 if there's none, an empty needle is found at 0 */
+s64 str8_find(Str8 haystack, Str8 needle) {
+  if(needle.len == 0) {
+    return 0;
+  }
 
-    found = i;
+  if(needle.len > haystack.len) {
+    return -1;
   }
 
-end:
+  Str8_find_func *func = atomic_read(&str8_find_func_);
 
-  return found;
+  return func(haystack, needle, 0);
 }
 
 b32 str8_starts_with(Str8 str, Str8 start) {
@@ -209,6 +328,18 @@ b32 str8_is_decimal(Str8 str) {
   return result;
 }
 
+/* FNV-1a, good enough for name tables and content hashes, not for anything adversarial */
+u64 str8_hash(Str8 str) {
+  u64 hash = 0xcbf29ce484222325ull;
+
+  for(s64 i = 0; i < str.len; i++) {
+    hash ^= (u64)str.s[i];
+    hash *= 0x100000001b3ull;
+  }
+
+  return hash;
+}
+
 Str8 push_str8_copy(Arena *a, Str8 str) {
   u8 *s = push_array_no_zero(a, u8, str.len + 1);
   memory_copy(s, str.s, str.len);